@@ -12,3 +12,53 @@ endif
 COMPONENT_VARS += UPNP_VERSION
 UPNP_VERSION ?= 1.0
 COMPONENT_CXXFLAGS += -DUPNP_VERSION=$(UPNP_VERSION)
+
+# Number of MessageSpec objects in static pool
+COMPONENT_VARS += SSDP_MESSAGE_POOL_SIZE
+SSDP_MESSAGE_POOL_SIZE ?= 16
+COMPONENT_CXXFLAGS += -DSSDP_MESSAGE_POOL_SIZE=$(SSDP_MESSAGE_POOL_SIZE)
+
+# Allocate from heap when message pool is exhausted
+COMPONENT_VARS += SSDP_MESSAGE_POOL_HEAP_FALLBACK
+SSDP_MESSAGE_POOL_HEAP_FALLBACK ?= 1
+COMPONENT_CXXFLAGS += -DSSDP_MESSAGE_POOL_HEAP_FALLBACK=$(SSDP_MESSAGE_POOL_HEAP_FALLBACK)
+
+# Largest message which may be sent
+COMPONENT_VARS += SSDP_MAX_MESSAGE_SIZE
+SSDP_MAX_MESSAGE_SIZE ?= 1400
+COMPONENT_CXXFLAGS += -DSSDP_MAX_MESSAGE_SIZE=$(SSDP_MAX_MESSAGE_SIZE)
+
+# Largest message which may be received
+COMPONENT_VARS += SSDP_MAX_RECEIVE_SIZE
+SSDP_MAX_RECEIVE_SIZE ?= 1400
+COMPONENT_CXXFLAGS += -DSSDP_MAX_RECEIVE_SIZE=$(SSDP_MAX_RECEIVE_SIZE)
+
+# Number of rendered messages to cache for re-sending
+COMPONENT_VARS += SSDP_TEMPLATE_CACHE_SIZE
+SSDP_TEMPLATE_CACHE_SIZE ?= 0
+COMPONENT_CXXFLAGS += -DSSDP_TEMPLATE_CACHE_SIZE=$(SSDP_TEMPLATE_CACHE_SIZE)
+
+# Maintain server statistics
+COMPONENT_VARS += SSDP_ENABLE_STATS
+SSDP_ENABLE_STATS ?= 0
+COMPONENT_CXXFLAGS += -DSSDP_ENABLE_STATS=$(SSDP_ENABLE_STATS)
+
+# Initial number of device UUIDs which may be registered for direct search responses
+COMPONENT_VARS += SSDP_DEVICE_REGISTRY_SIZE
+SSDP_DEVICE_REGISTRY_SIZE ?= 8
+COMPONENT_CXXFLAGS += -DSSDP_DEVICE_REGISTRY_SIZE=$(SSDP_DEVICE_REGISTRY_SIZE)
+
+# Number of URNs which may be registered for built-in search responses
+COMPONENT_VARS += SSDP_SEARCH_INDEX_SIZE
+SSDP_SEARCH_INDEX_SIZE ?= 16
+COMPONENT_CXXFLAGS += -DSSDP_SEARCH_INDEX_SIZE=$(SSDP_SEARCH_INDEX_SIZE)
+
+# Record events in a ring buffer for diagnostics
+COMPONENT_VARS += SSDP_ENABLE_TRACE
+SSDP_ENABLE_TRACE ?= 0
+COMPONENT_CXXFLAGS += -DSSDP_ENABLE_TRACE=$(SSDP_ENABLE_TRACE)
+
+# Number of trace events to retain, must be a power of 2
+COMPONENT_VARS += SSDP_TRACE_SIZE
+SSDP_TRACE_SIZE ?= 64
+COMPONENT_CXXFLAGS += -DSSDP_TRACE_SIZE=$(SSDP_TRACE_SIZE)
@@ -0,0 +1,281 @@
+#include <SmingCore.h>
+#include <Network/SSDP/Server.h>
+#include <Data/Stream/HostFileStream.h>
+#include <hostlib/CommandLine.h>
+
+namespace
+{
+/*
+ * Each datagram in the replay file is preceded by this header, little-endian
+ */
+struct RecordHeader {
+	uint32_t timestamp; ///< Milliseconds since start of capture
+	uint32_t remoteIP;	///< IPv4 address of sender, network byte order
+	uint16_t remotePort;
+	uint16_t length; ///< Number of bytes of datagram which follow
+};
+
+static_assert(sizeof(RecordHeader) == 12, "Bad RecordHeader size");
+
+constexpr unsigned batchSize{32};	  ///< Records delivered per task when running flat out
+constexpr unsigned reportIntervalMs{1000};
+
+DEFINE_FSTR_LOCAL(deviceUuid, "2fac1234-31f8-11b4-a222-08002b34c003")
+DEFINE_FSTR_LOCAL(deviceDomain, "schemas-upnp-org")
+DEFINE_FSTR_LOCAL(deviceType, "Basic")
+
+HostFileStream input;
+SimpleTimer replayTimer;
+SimpleTimer reportTimer;
+RecordHeader header;
+char buffer[2048];
+bool havePending;
+unsigned speed{1}; ///< Playback speed multiplier, 0 to replay as fast as possible
+uint32_t startTime;
+uint32_t firstTimestamp;
+int device; ///< Any unique address serves to identify the hosted device
+
+struct Counters {
+	uint32_t received;
+	uint32_t receivedBytes;
+	uint32_t delivered;
+	uint32_t sent;
+	uint32_t sentBytes;
+	uint32_t skipped;
+	uint64_t processTime;	 ///< Total time spent in `receive()`, microseconds
+	uint32_t maxProcessTime; ///< Highest `receive()` time since last report, microseconds
+};
+
+Counters counters;
+Counters lastCounters;
+uint32_t peakProcessTime; ///< Highest `receive()` time over whole run, microseconds
+uint32_t minFreeHeap;
+
+String getParameter(const char* name)
+{
+	auto param = commandLine.getParameters().findIgnoreCase(name);
+	return param.getValue();
+}
+
+/*
+ * Read the next record into buffer
+ * @retval bool false at end of file
+ */
+bool readRecord()
+{
+	while(input.readBytes(reinterpret_cast<char*>(&header), sizeof(header)) == sizeof(header)) {
+		if(header.length <= sizeof(buffer)) {
+			return input.readBytes(buffer, header.length) == header.length;
+		}
+		// Not a valid SSDP datagram
+		input.seekFrom(header.length, SeekOrigin::Current);
+		++counters.skipped;
+	}
+	return false;
+}
+
+void updateHeap()
+{
+	auto freeHeap = System.getFreeHeapSize();
+	if(minFreeHeap == 0 || freeHeap < minFreeHeap) {
+		minFreeHeap = freeHeap;
+	}
+}
+
+/*
+ * Average time per packet spent in `receive()`, in microseconds
+ */
+uint32_t averageProcessTime(const Counters& current, const Counters& last)
+{
+	auto count = current.received - last.received;
+	return count ? (current.processTime - last.processTime) / count : 0;
+}
+
+void report()
+{
+	updateHeap();
+	auto& pool = SSDP::MessagePool::getStats();
+	Serial << _F("RX ") << counters.received - lastCounters.received << _F(" msg/s, ")
+		   << counters.receivedBytes - lastCounters.receivedBytes << _F(" B/s; TX ")
+		   << counters.sent - lastCounters.sent << _F(" msg/s, ") << counters.sentBytes - lastCounters.sentBytes
+		   << _F(" B/s; queued ") << SSDP::server.messageQueue.count() << _F(", pool ") << pool.used << '/'
+		   << pool.peak << _F(" heap ") << pool.heapUsed << _F("; free heap ") << System.getFreeHeapSize()
+		   << _F(" (min ") << minFreeHeap << _F("); receive avg ") << averageProcessTime(counters, lastCounters)
+		   << _F(" us, max ") << counters.maxProcessTime << _F(" us") << endl;
+	lastCounters = counters;
+	counters.maxProcessTime = 0;
+}
+
+void finish()
+{
+	// Wait for scheduled responses to go out
+	if(SSDP::server.messageQueue.count() != 0) {
+		replayTimer.initializeMs<100>(finish).startOnce();
+		return;
+	}
+
+	reportTimer.stop();
+	report();
+
+	auto elapsed = millis() - startTime;
+	auto& pool = SSDP::MessagePool::getStats();
+	Serial << endl
+		   << _F("Replay complete in ") << elapsed << _F(" ms") << endl
+		   << _F("  Received:  ") << counters.received << _F(" datagrams, ") << counters.receivedBytes << _F(" bytes")
+		   << endl
+		   << _F("  Delivered: ") << counters.delivered << _F(" to application") << endl
+		   << _F("  Sent:      ") << counters.sent << _F(" datagrams, ") << counters.sentBytes << _F(" bytes") << endl
+		   << _F("  Skipped:   ") << counters.skipped << _F(" oversized records") << endl
+		   << _F("  Throughput: ") << (elapsed ? counters.received * 1000ULL / elapsed : 0) << _F(" msg/s") << endl
+		   << _F("  Receive:   avg ") << averageProcessTime(counters, Counters{}) << _F(" us, max ") << peakProcessTime
+		   << _F(" us per datagram") << endl
+		   << _F("  Pool peak: ") << pool.peak << _F(", heap allocations ") << pool.heapAllocations << _F(", failures ")
+		   << pool.failures << endl
+		   << _F("  Free heap: min ") << minFreeHeap << _F(", now ") << System.getFreeHeapSize() << endl;
+
+	exit(0);
+}
+
+void deliver()
+{
+	++counters.received;
+	counters.receivedBytes += header.length;
+	auto start = micros();
+	SSDP::server.receive(buffer, header.length, IpAddress(header.remoteIP), header.remotePort);
+	uint32_t elapsed = micros() - start;
+	counters.processTime += elapsed;
+	counters.maxProcessTime = std::max(counters.maxProcessTime, elapsed);
+	peakProcessTime = std::max(peakProcessTime, elapsed);
+	updateHeap();
+}
+
+/*
+ * Deliver all records which are due, then wait for the next one
+ */
+void replay()
+{
+	auto elapsed = millis() - startTime;
+	unsigned count{0};
+	while(havePending) {
+		if(speed == 0) {
+			if(count++ == batchSize) {
+				// Let queued messages and timers run
+				System.queueCallback(replay);
+				return;
+			}
+		} else {
+			uint32_t due = (header.timestamp - firstTimestamp) / speed;
+			if(due > elapsed) {
+				replayTimer.initializeMs(due - elapsed, replay).startOnce();
+				return;
+			}
+		}
+		deliver();
+		havePending = readRecord();
+	}
+
+	finish();
+}
+
+void onReceive(SSDP::BasicMessage& msg)
+{
+	(void)msg;
+	++counters.delivered;
+}
+
+/*
+ * Fill in the fields a device would normally provide
+ */
+void onSend(SSDP::Message& msg, SSDP::MessageSpec& ms)
+{
+	String uuid = F("uuid:") + deviceUuid;
+	String target;
+	switch(ms.match()) {
+	case SSDP::SearchMatch::root:
+		target = SSDP::UPNP_ROOTDEVICE;
+		break;
+	case SSDP::SearchMatch::uuid:
+		target = uuid;
+		break;
+	default:
+		target = Urn(Urn::Kind::device, nullptr, deviceDomain, deviceType, 1).toString();
+	}
+
+	if(msg.type == SSDP::MessageType::notify) {
+		msg["NT"] = target;
+	} else {
+		msg["ST"] = target;
+	}
+	msg["USN"] = (target == uuid) ? uuid : uuid + "::" + target;
+	msg[HTTP_HEADER_LOCATION] = F("http://192.168.1.10/description.xml");
+	SSDP::server.sendMessage(msg);
+}
+
+bool onSendSink(IpAddress remoteIP, uint16_t remotePort, const char* data, size_t length)
+{
+	(void)remoteIP;
+	(void)remotePort;
+	(void)data;
+	++counters.sent;
+	counters.sentBytes += length;
+	return true;
+}
+
+bool start()
+{
+	auto filename = getParameter("file");
+	if(!filename) {
+		Serial.println(_F("Usage: make run HOST_PARAMETERS='file=FILENAME [speed=N]'"));
+		return false;
+	}
+
+	if(!input.open(filename)) {
+		Serial << _F("Failed to open '") << filename << '\'' << endl;
+		return false;
+	}
+
+	auto speedParam = getParameter("speed");
+	if(speedParam) {
+		speed = speedParam.toInt();
+	}
+
+	// Host a single device so searches get responses
+	Uuid uuid(deviceUuid);
+	auto& server = SSDP::server;
+	server.addSearchTarget(Urn(Urn::Kind::root), &device);
+	server.addSearchTarget(Urn(uuid), &device);
+	server.addSearchTarget(Urn(Urn::Kind::device, uuid, deviceDomain, deviceType, 1), &device);
+	server.setDelegates(onReceive, onSend);
+	server.setSendSink(onSendSink);
+
+	havePending = readRecord();
+	if(!havePending) {
+		Serial.println(_F("No records found"));
+		return false;
+	}
+
+	Serial << _F("Replaying '") << filename << _F("' at ");
+	if(speed == 0) {
+		Serial << _F("full speed") << endl;
+	} else {
+		Serial << 'x' << speed << endl;
+	}
+
+	firstTimestamp = header.timestamp;
+	startTime = millis();
+	reportTimer.initializeMs<reportIntervalMs>(report).start();
+	replay();
+	return true;
+}
+
+} // namespace
+
+void init()
+{
+	Serial.begin(SERIAL_BAUD_RATE);
+	Serial.systemDebugOutput(false);
+
+	if(!start()) {
+		exit(1);
+	}
+}
@@ -0,0 +1,5 @@
+COMPONENT_SOC := host
+ARDUINO_LIBRARIES := SSDP
+
+# Traffic is injected directly so no TAP interface is required
+HOST_NETWORK_OPTIONS := --nonet
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+#
+# Convert a pcap capture into a replay file for the SSDP Replay sample.
+#
+# Only IPv4 UDP datagrams to or from port 1900 are extracted.
+# Supports Ethernet, Linux cooked (SLL) and raw IP link types.
+#
+
+import argparse
+import struct
+import sys
+
+SSDP_PORT = 1900
+
+LINKTYPE_ETHERNET = 1
+LINKTYPE_RAW = 101
+LINKTYPE_LINUX_SLL = 113
+
+
+def read_pcap(f):
+    header = f.read(24)
+    if len(header) < 24:
+        raise ValueError("File too short")
+    magic = header[:4]
+    if magic in (b'\xd4\xc3\xb2\xa1', b'\x4d\x3c\xb2\xa1'):
+        endian = '<'
+    elif magic in (b'\xa1\xb2\xc3\xd4', b'\xa1\xb2\x3c\x4d'):
+        endian = '>'
+    else:
+        raise ValueError("Not a pcap file (pcapng is not supported)")
+    nanoseconds = magic in (b'\x4d\x3c\xb2\xa1', b'\xa1\xb2\x3c\x4d')
+    linktype = struct.unpack(endian + 'I', header[20:24])[0]
+
+    while True:
+        rec = f.read(16)
+        if len(rec) < 16:
+            break
+        sec, frac, caplen, _ = struct.unpack(endian + 'IIII', rec)
+        data = f.read(caplen)
+        if len(data) < caplen:
+            break
+        usec = frac // 1000 if nanoseconds else frac
+        yield sec * 1000 + usec // 1000, linktype, data
+
+
+def get_ip_packet(linktype, data):
+    if linktype == LINKTYPE_ETHERNET:
+        offset = 12
+        ethertype = struct.unpack('>H', data[offset:offset + 2])[0]
+        # Skip VLAN tags
+        while ethertype in (0x8100, 0x88a8):
+            offset += 4
+            ethertype = struct.unpack('>H', data[offset:offset + 2])[0]
+        offset += 2
+    elif linktype == LINKTYPE_LINUX_SLL:
+        ethertype = struct.unpack('>H', data[14:16])[0]
+        offset = 16
+    elif linktype == LINKTYPE_RAW:
+        ethertype = 0x0800
+        offset = 0
+    else:
+        raise ValueError("Unsupported link type %u" % linktype)
+    if ethertype != 0x0800:
+        return None
+    return data[offset:]
+
+
+def get_udp_datagram(ip):
+    if len(ip) < 20 or ip[0] >> 4 != 4 or ip[9] != 17:
+        return None
+    # Fragments are not reassembled
+    if struct.unpack('>H', ip[6:8])[0] & 0x3fff:
+        return None
+    ihl = (ip[0] & 0x0f) * 4
+    udp = ip[ihl:]
+    if len(udp) < 8:
+        return None
+    src_port, dst_port, length = struct.unpack('>HHH', udp[:6])
+    if SSDP_PORT not in (src_port, dst_port):
+        return None
+    return ip[12:16], src_port, udp[8:length]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert pcap capture to SSDP replay file')
+    parser.add_argument('input', help='pcap capture file')
+    parser.add_argument('output', help='Replay file to create')
+    args = parser.parse_args()
+
+    count = 0
+    start = None
+    with open(args.input, 'rb') as fin, open(args.output, 'wb') as fout:
+        for timestamp, linktype, data in read_pcap(fin):
+            ip = get_ip_packet(linktype, data)
+            if ip is None:
+                continue
+            datagram = get_udp_datagram(ip)
+            if datagram is None:
+                continue
+            addr, port, payload = datagram
+            if start is None:
+                start = timestamp
+            fout.write(struct.pack('<I4sHH', (timestamp - start) & 0xffffffff, addr, port, len(payload)))
+            fout.write(payload)
+            count += 1
+
+    print("Wrote %u datagrams to '%s'" % (count, args.output))
+
+
+if __name__ == '__main__':
+    try:
+        main()
+    except ValueError as e:
+        sys.exit(str(e))
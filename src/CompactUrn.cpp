@@ -0,0 +1,181 @@
+/**
+ * CompactUrn.cpp
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "include/Network/SSDP/CompactUrn.h"
+#include <cstdlib>
+
+namespace
+{
+/*
+ * Strings are stored consecutively, each nul-terminated, in a single block.
+ * A table of entries records the position and length of each, and chains
+ * entries into hash buckets so lookups only compare likely candidates.
+ */
+struct Entry {
+	uint16_t offset;	 ///< Position of string in text block
+	uint8_t length;		 ///< Excludes nul terminator
+	UrnStrings::Id next; ///< Next entry in bucket chain
+};
+
+constexpr unsigned bucketCount{16};
+
+char* text;
+size_t textSize;
+Entry* entries;
+unsigned entryCount;
+UrnStrings::Id buckets[bucketCount];
+
+// FNV-1a
+unsigned getBucket(const char* s, size_t len)
+{
+	uint32_t hash{2166136261U};
+	while(len-- != 0) {
+		hash = (hash ^ uint8_t(*s++)) * 16777619U;
+	}
+	return (hash ^ (hash >> 16)) % bucketCount;
+}
+
+} // namespace
+
+UrnStrings::Id UrnStrings::find(const char* s, size_t len)
+{
+	if(s == nullptr || len == 0) {
+		return none;
+	}
+
+	for(auto id = buckets[getBucket(s, len)]; id != none;) {
+		auto& e = entries[id - 1];
+		if(e.length == len && memcmp(&text[e.offset], s, len) == 0) {
+			return id;
+		}
+		id = e.next;
+	}
+
+	return none;
+}
+
+UrnStrings::Id UrnStrings::intern(const char* s, size_t len)
+{
+	auto id = find(s, len);
+	if(id != none || len == 0) {
+		return id;
+	}
+
+	if(entryCount >= maxStrings || len > 0xff || textSize + len + 1 > 0xffff) {
+		return none;
+	}
+
+	auto newText = static_cast<char*>(realloc(text, textSize + len + 1));
+	if(newText == nullptr) {
+		return none;
+	}
+	text = newText;
+
+	auto newEntries = static_cast<Entry*>(realloc(entries, (entryCount + 1) * sizeof(Entry)));
+	if(newEntries == nullptr) {
+		return none;
+	}
+	entries = newEntries;
+
+	auto& bucket = buckets[getBucket(s, len)];
+	auto& e = entries[entryCount];
+	e.offset = textSize;
+	e.length = len;
+	e.next = bucket;
+	memcpy(&text[textSize], s, len);
+	text[textSize + len] = '\0';
+	textSize += len + 1;
+	++entryCount;
+	bucket = entryCount;
+
+	return entryCount;
+}
+
+const char* UrnStrings::get(Id id)
+{
+	if(id == none || id > entryCount) {
+		return nullptr;
+	}
+	return &text[entries[id - 1].offset];
+}
+
+unsigned UrnStrings::count()
+{
+	return entryCount;
+}
+
+UrnView CompactUrn::view(const Urn& urn)
+{
+	auto slice = [](const String& s) -> UrnView::Slice { return UrnView::Slice{s.c_str(), uint16_t(s.length())}; };
+
+	UrnView view;
+	view.kind = urn.kind;
+	view.uuid = slice(urn.uuid);
+	view.domain = slice(urn.domain);
+	view.type = slice(urn.type);
+	view.version = urn.version;
+	return view;
+}
+
+bool CompactUrn::set(const UrnView& view, bool intern)
+{
+	*this = CompactUrn{};
+	if(!view) {
+		return false;
+	}
+
+	if(view.uuid && !uuid.decompose(view.uuid.ptr, view.uuid.length)) {
+		return false;
+	}
+
+	auto getId = [intern](const UrnView::Slice& slice, UrnStrings::Id& id) -> bool {
+		if(!slice) {
+			return true;
+		}
+		id = intern ? UrnStrings::intern(slice.ptr, slice.length) : UrnStrings::find(slice.ptr, slice.length);
+		return id != UrnStrings::none;
+	};
+
+	if(!getId(view.domain, domain) || !getId(view.type, type)) {
+		return false;
+	}
+
+	kind = view.kind;
+	version = view.version;
+	return true;
+}
+
+Urn CompactUrn::toUrn() const
+{
+	Urn urn(kind);
+	if(uuid) {
+		urn.uuid = uuid.toString();
+	}
+	urn.domain = UrnStrings::get(domain);
+	urn.type = UrnStrings::get(type);
+	urn.version = version;
+	return urn;
+}
+
+uint32_t CompactUrn::hash() const
+{
+	uint32_t hash = uuid.hash();
+	hash ^= (unsigned(kind) << 24) | (version << 16) | (domain << 8) | type;
+	return hash * 16777619U;
+}
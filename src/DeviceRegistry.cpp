@@ -0,0 +1,215 @@
+/**
+ * DeviceRegistry.cpp
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "debug.h"
+#include "include/Network/SSDP/DeviceRegistry.h"
+#include <new>
+
+namespace SSDP
+{
+#if SSDP_DEVICE_REGISTRY_SIZE
+
+int DeviceRegistry::indexOf(const Uuid& uuid) const
+{
+	auto i = home(uuid);
+	for(unsigned n = 0; n < tableSize; ++n) {
+		auto& e = entries[i];
+		if(e.object == nullptr) {
+			break;
+		}
+		if(e.uuid == uuid) {
+			return i;
+		}
+		i = nextIndex(i);
+	}
+	return -1;
+}
+
+bool DeviceRegistry::add(const Uuid& uuid, void* object)
+{
+	if(object == nullptr) {
+		return false;
+	}
+
+	auto i = indexOf(uuid);
+	if(i >= 0) {
+		entries[i].object = object;
+		return true;
+	}
+
+	// Keep table no more than three-quarters full. If it can't be enlarged, use what room remains.
+	if((itemCount + 1) * 4 > tableSize * 3) {
+		grow();
+	}
+
+	if(itemCount == tableSize) {
+		debug_w("[SSDP] Device registry full (%u entries)", tableSize);
+		return false;
+	}
+
+	insert(uuid, object);
+	return true;
+}
+
+/*
+ * Place a new entry in the first free slot of its probe chain. Table must not be full.
+ */
+void DeviceRegistry::insert(const Uuid& uuid, void* object)
+{
+	auto i = home(uuid);
+	while(entries[i].object != nullptr) {
+		i = nextIndex(i);
+	}
+	entries[i].uuid = uuid;
+	entries[i].object = object;
+	++itemCount;
+}
+
+bool DeviceRegistry::grow()
+{
+	auto newSize = tableSize * 2;
+	auto newEntries = new(std::nothrow) Entry[newSize];
+	if(newEntries == nullptr) {
+		debug_w("[SSDP] Device registry not resized");
+		return false;
+	}
+
+	auto oldEntries = entries;
+	auto oldSize = tableSize;
+	entries = newEntries;
+	tableSize = newSize;
+	itemCount = 0;
+	for(unsigned i = 0; i < oldSize; ++i) {
+		auto& e = oldEntries[i];
+		if(e.object != nullptr) {
+			insert(e.uuid, e.object);
+		}
+	}
+
+	if(oldEntries != initialEntries) {
+		delete[] oldEntries;
+	}
+
+	debug_d("[SSDP] Device registry resized to %u entries", newSize);
+	return true;
+}
+
+void DeviceRegistry::removeAt(unsigned index)
+{
+	/*
+	 * Backward-shift deletion: move any following entries which would not otherwise be
+	 * reachable from their home slot into the gap.
+	 */
+	auto gap = index;
+	entries[gap] = Entry{};
+	--itemCount;
+
+	auto i = nextIndex(gap);
+	while(entries[i].object != nullptr) {
+		auto h = home(entries[i].uuid);
+		// Entry can fill the gap if its home slot is not cyclically within (gap, i]
+		bool canMove = (gap <= i) ? (h <= gap || h > i) : (h <= gap && h > i);
+		if(canMove) {
+			entries[gap] = entries[i];
+			entries[i] = Entry{};
+			gap = i;
+		}
+		i = nextIndex(i);
+	}
+}
+
+bool DeviceRegistry::remove(const Uuid& uuid)
+{
+	auto i = indexOf(uuid);
+	if(i < 0) {
+		return false;
+	}
+	removeAt(i);
+	return true;
+}
+
+void DeviceRegistry::remove(void* object)
+{
+	if(object == nullptr) {
+		return;
+	}
+
+	/*
+	 * Backward-shift deletion can move an entry from beyond the end of the table into
+	 * a slot we've already scanned, so repeat until a full pass finds nothing.
+	 */
+	bool removed;
+	do {
+		removed = false;
+		for(unsigned i = 0; i < tableSize; ++i) {
+			if(entries[i].object == object) {
+				removeAt(i);
+				removed = true;
+			}
+		}
+	} while(removed);
+}
+
+void* DeviceRegistry::find(const Uuid& uuid) const
+{
+	auto i = indexOf(uuid);
+	return (i < 0) ? nullptr : entries[i].object;
+}
+
+void DeviceRegistry::clear()
+{
+	if(entries != initialEntries) {
+		delete[] entries;
+		entries = initialEntries;
+		tableSize = initialCapacity;
+	}
+	for(auto& e : initialEntries) {
+		e = Entry{};
+	}
+	itemCount = 0;
+}
+
+#else
+
+bool DeviceRegistry::add(const Uuid&, void*)
+{
+	return false;
+}
+
+bool DeviceRegistry::remove(const Uuid&)
+{
+	return false;
+}
+
+void DeviceRegistry::remove(void*)
+{
+}
+
+void* DeviceRegistry::find(const Uuid&) const
+{
+	return nullptr;
+}
+
+void DeviceRegistry::clear()
+{
+}
+
+#endif
+
+} // namespace SSDP
@@ -0,0 +1,387 @@
+/**
+ * DiscoveryCache.cpp
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "debug.h"
+#include "include/Network/SSDP/DiscoveryCache.h"
+#include <FlashString/Vector.hpp>
+#include <algorithm>
+#include <new>
+
+namespace
+{
+#define XX(tag, comment) DEFINE_FSTR_LOCAL(str_event_##tag, #tag)
+SSDP_DISCOVERY_EVENT_MAP(XX)
+#undef XX
+
+#define XX(tag, comment) &str_event_##tag,
+DEFINE_FSTR_VECTOR(eventStrings, FlashString, SSDP_DISCOVERY_EVENT_MAP(XX))
+#undef XX
+
+// FNV-1a
+uint32_t hashString(const char* s)
+{
+	uint32_t hash{2166136261U};
+	while(*s != '\0') {
+		hash = (hash ^ uint8_t(*s++)) * 16777619U;
+	}
+	return hash;
+}
+
+/*
+ * Get max-age value from CACHE-CONTROL header, e.g. "max-age = 1800"
+ */
+unsigned getMaxAge(const char* value)
+{
+	if(value != nullptr) {
+		for(auto p = value; *p != '\0'; ++p) {
+			if(strncasecmp(p, "max-age", 7) != 0) {
+				continue;
+			}
+			p += 7;
+			while(*p == ' ') {
+				++p;
+			}
+			if(*p == '=') {
+				return atoi(p + 1);
+			}
+			break;
+		}
+	}
+	return SSDP::DiscoveryCache::defaultMaxAge;
+}
+
+bool equals(const char* a, const char* b)
+{
+	return strcmp(a ?: "", b ?: "") == 0;
+}
+
+} // namespace
+
+namespace SSDP
+{
+DiscoveryCache::DiscoveryCache(uint16_t maxEntries, uint16_t arenaSize)
+	: arenaSize(arenaSize ?: std::min(maxEntries * defaultEntrySize, 0xffff)), maxEntries(maxEntries)
+{
+	timer.setCallback([this]() { onSweep(); });
+	timer.setIntervalMs(sweepInterval * 1000U);
+}
+
+DiscoveryCache::~DiscoveryCache()
+{
+	free(arena);
+}
+
+uint16_t* DiscoveryCache::findLink(const char* usn, uint32_t hash)
+{
+	auto link = &buckets[hash % bucketCount];
+	for(; *link != 0; link = &get(*link)->next) {
+		auto e = get(*link);
+		if(e->hash == hash && strcmp(e->usn(), usn) == 0) {
+			break;
+		}
+	}
+	return link;
+}
+
+const DiscoveryCache::Entry* DiscoveryCache::find(const char* usn) const
+{
+	if(usn == nullptr) {
+		return nullptr;
+	}
+
+	auto e = get(*const_cast<DiscoveryCache*>(this)->findLink(usn, hashString(usn)));
+	if(e == nullptr || int(e->expires - clock) <= 0) {
+		return nullptr;
+	}
+	return e;
+}
+
+/*
+ * Ensure there's room at the end of the arena, compacting it if necessary.
+ * Entries may be in use by a callback, in which case they must not be moved.
+ */
+bool DiscoveryCache::reserve(size_t size)
+{
+	if(arena == nullptr) {
+		arena = static_cast<uint8_t*>(malloc(arenaSize));
+		if(arena == nullptr) {
+			debug_e("[SSDP] Discovery cache allocation failed");
+			return false;
+		}
+	}
+
+	if(arenaUsed + size > arenaSize && busy == 0) {
+		compact();
+	}
+
+	if(arenaUsed + size > arenaSize) {
+		debug_w("[SSDP] Discovery cache arena full");
+		return false;
+	}
+
+	return true;
+}
+
+DiscoveryCache::Entry* DiscoveryCache::createEntry(uint32_t hash, const char* usn, const char* type,
+												   const char* location)
+{
+	auto usnLen = strlen(usn) + 1;
+	auto typeLen = strlen(type) + 1;
+	auto locationLen = strlen(location) + 1;
+	auto size = sizeof(Entry) + usnLen + typeLen + locationLen;
+	size = (size + alignof(Entry) - 1) & ~(alignof(Entry) - 1);
+	if(!reserve(size)) {
+		return nullptr;
+	}
+
+	auto e = new(arena + arenaUsed) Entry;
+	arenaUsed += size;
+	e->hash = hash;
+	e->size = size;
+	e->next = 0;
+	e->typeOffset = usnLen;
+	e->locationOffset = usnLen + typeLen;
+	e->state = Entry::State::live;
+	memcpy(e->text(), usn, usnLen);
+	memcpy(e->text() + e->typeOffset, type, typeLen);
+	memcpy(e->text() + e->locationOffset, location, locationLen);
+	return e;
+}
+
+/*
+ * Take an entry out of the index. Its space is kept until the callback has been invoked.
+ */
+void DiscoveryCache::unlink(uint16_t* link)
+{
+	auto e = get(*link);
+	*link = e->next;
+	e->state = Entry::State::removing;
+	--itemCount;
+}
+
+/*
+ * Invoke callback for unlinked entries. As these are no longer in the index,
+ * the callback may add or remove entries without disturbing the caller.
+ */
+void DiscoveryCache::notifyRemoved()
+{
+	++busy;
+	for(unsigned pos = 0; pos < arenaUsed;) {
+		auto e = reinterpret_cast<Entry*>(arena + pos);
+		if(e->state == Entry::State::removing) {
+			e->state = Entry::State::dead;
+			if(callback) {
+				callback(Event::removed, *e);
+			}
+		}
+		pos += e->size;
+	}
+	--busy;
+
+	if(itemCount == 0) {
+		timer.stop();
+	}
+}
+
+/*
+ * Move live entries down over dead ones and rebuild the index
+ */
+void DiscoveryCache::compact()
+{
+	unsigned used{0};
+	for(unsigned pos = 0; pos < arenaUsed;) {
+		auto e = reinterpret_cast<Entry*>(arena + pos);
+		auto size = e->size;
+		if(e->state == Entry::State::live) {
+			if(used != pos) {
+				memmove(arena + used, e, size);
+			}
+			used += size;
+		}
+		pos += size;
+	}
+	arenaUsed = used;
+
+	memset(buckets, 0, sizeof(buckets));
+	for(unsigned pos = 0; pos < arenaUsed;) {
+		auto e = reinterpret_cast<Entry*>(arena + pos);
+		auto& head = buckets[e->hash % bucketCount];
+		e->next = head;
+		head = linkTo(e);
+		pos += e->size;
+	}
+}
+
+bool DiscoveryCache::update(const BasicMessage& msg)
+{
+	const char* type;
+	auto nts = NotifySubtype::alive;
+	if(msg.type == MessageType::notify) {
+		type = msg[HeaderId::nt];
+		auto s = msg[HeaderId::nts];
+		nts = s ? getNotifySubtype(s) : NotifySubtype::OTHER;
+	} else if(msg.type == MessageType::response) {
+		type = msg[HeaderId::st];
+	} else {
+		return false;
+	}
+
+	auto usn = msg[HeaderId::usn];
+	if(usn == nullptr || *usn == '\0') {
+		return false;
+	}
+
+	auto hash = hashString(usn);
+	auto link = findLink(usn, hash);
+
+	if(nts == NotifySubtype::byebye) {
+		if(*link != 0) {
+			unlink(link);
+			notifyRemoved();
+		}
+		return true;
+	}
+
+	if(nts != NotifySubtype::alive && nts != NotifySubtype::update) {
+		return false;
+	}
+
+	type = type ?: "";
+	auto location = msg[HeaderId::location] ?: "";
+	auto expires = clock + getMaxAge(msg[HeaderId::cacheControl]);
+
+	auto e = get(*link);
+	if(e != nullptr && equals(e->type(), type) && equals(e->location(), location)) {
+		// Refresh only
+		e->expires = expires;
+		return true;
+	}
+
+	if(e == nullptr && itemCount >= maxEntries) {
+		debug_w("[SSDP] Discovery cache full, ignoring %s", usn);
+		return true;
+	}
+
+	auto newEntry = createEntry(hash, usn, type, location);
+	if(newEntry == nullptr) {
+		return true;
+	}
+	newEntry->expires = expires;
+
+	// Arena may have been compacted
+	link = findLink(usn, hash);
+	e = get(*link);
+
+	Event event;
+	if(e == nullptr) {
+		auto& head = buckets[hash % bucketCount];
+		newEntry->next = head;
+		head = linkTo(newEntry);
+		++itemCount;
+		event = Event::added;
+		if(!timer.isStarted()) {
+			timer.start();
+		}
+	} else {
+		// Replace existing entry in the same position
+		newEntry->next = e->next;
+		*link = linkTo(newEntry);
+		e->state = Entry::State::dead;
+		event = Event::changed;
+	}
+
+	debug_d("[SSDP] Discovery %s: %s", toString(event).c_str(), usn);
+
+	if(callback) {
+		++busy;
+		callback(event, *newEntry);
+		--busy;
+	}
+
+	return true;
+}
+
+bool DiscoveryCache::remove(const char* usn)
+{
+	if(usn == nullptr) {
+		return false;
+	}
+
+	auto link = findLink(usn, hashString(usn));
+	if(*link == 0) {
+		return false;
+	}
+
+	unlink(link);
+	notifyRemoved();
+	return true;
+}
+
+void DiscoveryCache::expire()
+{
+	bool expired{false};
+	for(auto& head : buckets) {
+		auto link = &head;
+		while(*link != 0) {
+			auto e = get(*link);
+			if(int(e->expires - clock) <= 0) {
+				unlink(link);
+				expired = true;
+			} else {
+				link = &e->next;
+			}
+		}
+	}
+
+	if(expired) {
+		notifyRemoved();
+	}
+}
+
+void DiscoveryCache::onSweep()
+{
+	clock += sweepInterval;
+	expire();
+}
+
+void DiscoveryCache::clear()
+{
+	timer.stop();
+	memset(buckets, 0, sizeof(buckets));
+	itemCount = 0;
+
+	if(busy == 0) {
+		arenaUsed = 0;
+		return;
+	}
+
+	// Called from a callback, so entries must stay where they are
+	for(unsigned pos = 0; pos < arenaUsed;) {
+		auto e = reinterpret_cast<Entry*>(arena + pos);
+		e->state = Entry::State::dead;
+		pos += e->size;
+	}
+}
+
+} // namespace SSDP
+
+String toString(SSDP::DiscoveryCache::Event event)
+{
+	return eventStrings[unsigned(event)];
+}
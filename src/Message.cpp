@@ -30,6 +30,29 @@ SSDP_MESSAGE_TYPE_MAP(XX)
 #define XX(tag) &str_msgtype_##tag,
 DEFINE_FSTR_VECTOR(msgtypeStrings, FlashString, SSDP_MESSAGE_TYPE_MAP(XX))
 #undef XX
+
+#define XX(tag, name) DEFINE_FSTR_LOCAL(str_header_##tag, name)
+SSDP_HEADER_MAP(XX)
+#undef XX
+
+#define XX(tag, name) &str_header_##tag,
+DEFINE_FSTR_VECTOR(headerStrings, FlashString, SSDP_HEADER_MAP(XX))
+#undef XX
+
+/*
+ * Header names in RAM for fast classification
+ */
+struct HeaderName {
+	const char* name;
+	uint8_t length;
+};
+
+const HeaderName headerNames[]{
+#define XX(tag, name) {name, sizeof(name) - 1},
+	SSDP_HEADER_MAP(XX)
+#undef XX
+};
+
 } // namespace
 
 namespace SSDP
@@ -52,18 +75,46 @@ Message::Message(const BasicMessage& msg)
 	}
 }
 
+HeaderId getHeaderId(const char* name)
+{
+	if(name == nullptr) {
+		return HeaderId::MAX;
+	}
+
+	// Compare lengths first so most names are rejected without a string comparison
+	auto len = strlen(name);
+	for(unsigned i = 0; i < unsigned(HeaderId::MAX); ++i) {
+		auto& h = headerNames[i];
+		if(h.length == len && strcasecmp(h.name, name) == 0) {
+			return HeaderId(i);
+		}
+	}
+	return HeaderId::MAX;
+}
+
 HttpError BasicMessage::parse(char* data, size_t len)
 {
+	memset(slots, 0, sizeof(slots));
+
 	auto err = BasicHttpHeaders::parse(data, len, HTTP_BOTH);
 	if(err != HPE_OK) {
 		return err;
 	}
 
+	// Index well-known headers, first occurrence wins
+	for(unsigned i = 0; i < count(); ++i) {
+		auto& header = BasicHttpHeaders::operator[](i);
+		auto id = getHeaderId(header.name);
+		if(id != HeaderId::MAX && slots[unsigned(id)] == nullptr) {
+			slots[unsigned(id)] = header.value;
+		}
+	}
+
 	switch(BasicHttpHeaders::type()) {
 	case HTTP_REQUEST:
 		switch(BasicHttpHeaders::method()) {
 		case HttpMethod::MSEARCH: {
-			auto man = operator[]("MAN");
+			auto man = operator[](HeaderId::man);
 			if(SSDP_DISCOVER != man) {
 				debug_e("[SSDP] MAN field wrong (%s)", man ?: "(null)");
 				err = HPE_INVALID_HEADER_TOKEN;
@@ -93,9 +144,26 @@ HttpError BasicMessage::parse(char* data, size_t len)
 	return err;
 }
 
+uint8_t getMaxWait(const char* mx)
+{
+	int seconds = mx ? atoi(mx) : 0;
+	if(seconds < minMaxWait) {
+		return minMaxWait;
+	}
+	if(seconds > maxMaxWait) {
+		return maxMaxWait;
+	}
+	return seconds;
+}
+
 }; // namespace SSDP
 
 String toString(SSDP::MessageType type)
 {
 	return msgtypeStrings[unsigned(type)];
 }
+
+String toString(SSDP::HeaderId id)
+{
+	return headerStrings[unsigned(id)];
+}
@@ -0,0 +1,206 @@
+/**
+ * MessagePool.cpp
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "debug.h"
+#include "include/Network/SSDP/MessagePool.h"
+#include "include/Network/SSDP/MessageSpec.h"
+#include <new>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+using Index = SSDP::MessagePool::Index;
+
+/*
+ * Free entries hold a pointer to the next free entry
+ */
+union Entry {
+	Entry* next;
+	alignas(SSDP::MessageSpec) uint8_t storage[sizeof(SSDP::MessageSpec)];
+};
+
+/*
+ * Heap allocations are prefixed with their index
+ */
+union HeapHeader {
+	Index index;
+	std::max_align_t align;
+};
+
+#if SSDP_MESSAGE_POOL_SIZE
+Entry entries[SSDP_MESSAGE_POOL_SIZE];
+#else
+Entry* entries{nullptr};
+#endif
+Entry* freeList{nullptr};
+bool initialised{false};
+
+/*
+ * Heap allocations, by index. Unused slots form a free list.
+ */
+union OverflowSlot {
+	void* ptr;		   ///< Allocation, when in use
+	unsigned nextFree; ///< Next free slot + 1, 0 at end of list
+};
+
+OverflowSlot* overflow{nullptr};
+unsigned overflowSize{0};
+unsigned overflowFree{0}; ///< First free slot + 1, 0 if none
+
+void init()
+{
+	for(unsigned i = 0; i < SSDP::MessagePool::capacity; ++i) {
+		entries[i].next = freeList;
+		freeList = &entries[i];
+	}
+	initialised = true;
+}
+
+bool isPoolEntry(const void* ptr)
+{
+	auto entry = static_cast<const Entry*>(ptr);
+	return entry >= &entries[0] && entry < &entries[SSDP::MessagePool::capacity];
+}
+
+/*
+ * Double the size of the overflow table, so re-allocations are rare
+ */
+bool growOverflow()
+{
+	constexpr unsigned maxSize{0xffff - SSDP::MessagePool::capacity};
+	constexpr unsigned minSize{8};
+	if(overflowSize >= maxSize) {
+		return false;
+	}
+	unsigned newSize = std::min(std::max(overflowSize * 2, minSize), maxSize);
+	auto table = static_cast<OverflowSlot*>(realloc(overflow, newSize * sizeof(OverflowSlot)));
+	if(table == nullptr) {
+		return false;
+	}
+
+	// Chain new slots so lowest is used first
+	for(unsigned slot = newSize; slot > overflowSize; --slot) {
+		table[slot - 1].nextFree = overflowFree;
+		overflowFree = slot;
+	}
+	overflow = table;
+	overflowSize = newSize;
+	return true;
+}
+
+void* allocateHeap(size_t size)
+{
+	if(overflowFree == 0 && !growOverflow()) {
+		return nullptr;
+	}
+
+	auto header = static_cast<HeapHeader*>(::operator new(sizeof(HeapHeader) + size, std::nothrow));
+	if(header == nullptr) {
+		return nullptr;
+	}
+	unsigned slot = overflowFree - 1;
+	overflowFree = overflow[slot].nextFree;
+	header->index = SSDP::MessagePool::capacity + 1 + slot;
+	auto ptr = header + 1;
+	overflow[slot].ptr = ptr;
+	return ptr;
+}
+
+} // namespace
+
+namespace SSDP
+{
+MessagePool::Stats MessagePool::stats{};
+
+void* MessagePool::allocate(size_t size)
+{
+	if(!initialised) {
+		init();
+	}
+
+	if(size <= sizeof(Entry) && freeList != nullptr) {
+		auto entry = freeList;
+		freeList = entry->next;
+		++stats.used;
+		if(stats.used > stats.peak) {
+			stats.peak = stats.used;
+		}
+		return entry;
+	}
+
+	if(heapFallback) {
+		auto ptr = allocateHeap(size);
+		if(ptr != nullptr) {
+			++stats.heapUsed;
+			++stats.heapAllocations;
+			return ptr;
+		}
+	}
+
+	++stats.failures;
+	debug_w("[SSDP] MessageSpec allocation failed (%u in use)", stats.used + stats.heapUsed);
+	return nullptr;
+}
+
+void MessagePool::release(void* ptr)
+{
+	if(ptr == nullptr) {
+		return;
+	}
+
+	if(isPoolEntry(ptr)) {
+		auto entry = static_cast<Entry*>(ptr);
+		entry->next = freeList;
+		freeList = entry;
+		--stats.used;
+		return;
+	}
+
+	auto header = static_cast<HeapHeader*>(ptr) - 1;
+	unsigned slot = header->index - capacity - 1;
+	overflow[slot].nextFree = overflowFree;
+	overflowFree = slot + 1;
+	::operator delete(header);
+	--stats.heapUsed;
+}
+
+MessagePool::Index MessagePool::indexOf(const void* ptr)
+{
+	if(isPoolEntry(ptr)) {
+		return 1 + (static_cast<const Entry*>(ptr) - &entries[0]);
+	}
+
+	return (static_cast<const HeapHeader*>(ptr) - 1)->index;
+}
+
+void* MessagePool::get(Index index)
+{
+	if(index == none) {
+		return nullptr;
+	}
+	if(index <= capacity) {
+		return &entries[index - 1];
+	}
+	return overflow[index - capacity - 1].ptr;
+}
+
+} // namespace SSDP
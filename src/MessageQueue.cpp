@@ -19,26 +19,50 @@
 
 #include "debug.h"
 #include "include/Network/SSDP/MessageQueue.h"
+#include <algorithm>
+
+namespace
+{
+constexpr uint32_t minimumTimerInterval = Timer::Millis::timeToTicks<1>();
+
+/*
+ * Rotate bitmap so bit 0 corresponds to slot `first`
+ */
+inline uint32_t rotate(uint32_t bits, unsigned first)
+{
+	return (bits >> first) | (bits << ((32 - first) & 31));
+}
+
+} // namespace
 
 namespace SSDP
 {
-MessageQueue::MessageQueue(MessageDelegate delegate) : delegate(delegate)
+MessageQueue::MessageQueue(MessageDelegate delegate, uint8_t instance) : delegate(delegate), instance(instance)
 {
 	assert(delegate);
 
 	timer.setCallback([this]() {
 		timerSet = false;
-		if(head == nullptr) {
-			debug_e("[SSDP] Unexpected: Task queue empty");
+		SSDP_STAT(++fireCount);
+		advance(jiffies());
+
+		if(readyHead == none) {
+			// Woke early, or work was removed
+			setTimer();
 			return;
 		}
 
 		// Remove item from queue
-		auto ms = head;
-		head = head->next;
-		ms->next = nullptr;
+		auto ms = get(readyHead);
+		unlink(ms);
+		unindex(ms);
+		--itemCount;
+		if(isSpaced(*ms)) {
+			lastDispatchTicks = Timer::Clock::ticks();
+		}
 
 		debug_d("[SSDP] Timer fired, %s for %p", toString(ms->type()).c_str(), ms->object<void*>());
+		SSDP_TRACE(this->instance, timer, uint8_t(ms->type()), itemCount, uint32_t(uintptr_t(ms->object<void>())));
 
 		// We're no longer responsible for ms
 		this->delegate(ms);
@@ -53,30 +77,44 @@ MessageQueue::MessageQueue(MessageDelegate delegate) : delegate(delegate)
 void MessageQueue::clear()
 {
 	timer.stop();
+	timerSet = false;
 
-	auto p = head;
-	while(p != nullptr) {
-		auto next = p->next;
-		delete p;
-		p = next;
+	auto deleteList = [](Index i) {
+		while(i != none) {
+			auto p = get(i);
+			i = p->next;
+			delete p;
+		}
+	};
+
+	deleteList(readyHead);
+	readyHead = readyTail = none;
+
+	for(unsigned level = 0; level < wheelLevels; ++level) {
+		for(auto& slot : slots[level]) {
+			deleteList(slot);
+			slot = none;
+		}
+		occupied[level] = 0;
 	}
-	head = nullptr;
+
+	resetIndex();
+	itemCount = wheelCount = 0;
 }
 
-unsigned MessageQueue::count()
+uint32_t MessageQueue::jiffies() const
 {
-	unsigned n = 0;
-	auto p = head;
-	while(p != nullptr) {
-		++n;
-		p = p->next;
-	}
-	return n;
+	constexpr uint32_t resolutionTicks = Timer::Millis::timeToTicks<resolutionMs>();
+	int elapsed = Timer::Clock::ticks() - currentTicks;
+	return (elapsed <= 0) ? current : current + uint32_t(elapsed) / resolutionTicks;
 }
 
 void MessageQueue::add(MessageSpec* ms, uint32_t intervalMs)
 {
-	assert(ms != nullptr);
+	if(ms == nullptr) {
+		debug_w("[SSDP] MessageQueue::add() called with nullptr");
+		return;
+	}
 
 	debug_d("[SSDP] MessageQueue::add(%u)", intervalMs);
 	debug_d("  .object  = %p", ms->object<void*>());
@@ -86,42 +124,319 @@ void MessageQueue::add(MessageSpec* ms, uint32_t intervalMs)
 	debug_d("  .match   = %s", toString(ms->match()).c_str());
 	debug_d("  .target  = %s", toString(ms->target()).c_str());
 	debug_d("  .repeat  = %u", ms->repeat());
+	SSDP_TRACE(instance, enqueue, uint8_t(ms->type()), std::min<uint32_t>(intervalMs, 0xffff),
+			   uint32_t(uintptr_t(ms->object<void>())));
 
-	uint32_t due = Timer::Clock::ticks() + Timer::Millis::timeToTicks(intervalMs);
+#if SSDP_ENABLE_STATS
+	if(stamping && ms->type() == MessageType::response && !ms->hasReceived()) {
+		ms->setReceived(receiveTicks);
+	}
+#endif
 
-	MessageSpec* prev = nullptr;
-	auto p = head;
-	while(p != nullptr) {
-		if(int(p->due - due) > 0) {
-			break;
-		}
-		prev = p;
-		p = p->next;
+	if(wheelCount == 0) {
+		// Nothing depends on the current wheel position so re-synchronise it with the clock
+		currentTicks = Timer::Clock::ticks();
+	}
+
+	/*
+	 * Whole jiffies are taken directly from the interval, as long intervals would overflow
+	 * the clock tick range. Only the part of a jiffy left over, plus the time elapsed since
+	 * the start of `current`, is converted to ticks. Round up so message is never sent early.
+	 */
+	constexpr uint32_t resolutionTicks = Timer::Millis::timeToTicks<resolutionMs>();
+	int ticks = Timer::Clock::ticks() + Timer::Millis::timeToTicks(intervalMs % resolutionMs) - currentTicks;
+	ms->due = current + intervalMs / resolutionMs;
+	if(ticks > 0) {
+		ms->due += (uint32_t(ticks) + resolutionTicks - 1) / resolutionTicks;
 	}
+	insert(ms);
+	++itemCount;
+	SSDP_STAT(peakCount = std::max(peakCount, itemCount));
 
-	ms->next = p;
-	ms->due = due;
-	if(prev == nullptr) {
-		head = ms;
+	if(itemCount > indexSize()) {
+		growIndex();
+	}
+	push(objectIndex[objectHash(ms->m_object) & indexMask()], ms, &MessageSpec::objectNext, &MessageSpec::objectPrev);
+	push(specIndex[ms->hash() & indexMask()], ms, &MessageSpec::specNext, &MessageSpec::specPrev);
+
+	if(!timerSet || (readyHead == none && int(ms->due - timerJiffy) < 0)) {
 		setTimer();
+	}
+}
+
+/*
+ * Add a message to the head of a list
+ */
+void MessageQueue::push(Index& head, MessageSpec* ms, Link next, Link prev)
+{
+	auto index = MessagePool::indexOf(ms);
+	ms->*prev = none;
+	ms->*next = head;
+	if(head != none) {
+		get(head)->*prev = index;
+	}
+	head = index;
+}
+
+/*
+ * Remove a message from a list
+ */
+void MessageQueue::unchain(Index& head, MessageSpec* ms, Link next, Link prev)
+{
+	if(ms->*prev == none) {
+		head = ms->*next;
 	} else {
-		prev->next = ms;
+		get(ms->*prev)->*next = ms->*next;
 	}
+	if(ms->*next != none) {
+		get(ms->*next)->*prev = ms->*prev;
+	}
+}
+
+/*
+ * Place a message in the appropriate wheel slot according to how far away it is.
+ */
+void MessageQueue::insert(MessageSpec* ms)
+{
+	uint32_t due = ms->due;
+	if(int(due - current) < 0) {
+		due = current;
+	}
+	uint32_t delta = due - current;
+	if(delta >= wheelSpan) {
+		// Park at the furthest slot, will get re-cascaded when visited
+		due = current + wheelSpan - 1;
+		delta = wheelSpan - 1;
+	}
+
+	unsigned level = 0;
+	while(delta >= (1U << (wheelBits * (level + 1)))) {
+		++level;
+	}
+	unsigned index = (due >> (wheelBits * level)) & wheelMask;
+
+	ms->slot = (level << wheelBits) | index;
+	push(slots[level][index], ms, &MessageSpec::next, &MessageSpec::prev);
+	occupied[level] |= 1U << index;
+	++wheelCount;
+}
+
+/*
+ * Remove a message from whichever wheel slot or ready list it's in
+ */
+void MessageQueue::unlink(MessageSpec* ms)
+{
+	if(ms->slot == readySlot) {
+		if(ms->next == none) {
+			readyTail = ms->prev;
+		}
+		unchain(readyHead, ms, &MessageSpec::next, &MessageSpec::prev);
+	} else {
+		unsigned level = ms->slot >> wheelBits;
+		unsigned index = ms->slot & wheelMask;
+		auto& head = slots[level][index];
+		unchain(head, ms, &MessageSpec::next, &MessageSpec::prev);
+		if(head == none) {
+			occupied[level] &= ~(1U << index);
+		}
+		--wheelCount;
+	}
+
+	ms->next = ms->prev = none;
+}
+
+/*
+ * Remove a message from the object and identity indices
+ */
+void MessageQueue::unindex(MessageSpec* ms)
+{
+	unchain(objectIndex[objectHash(ms->m_object) & indexMask()], ms, &MessageSpec::objectNext,
+			&MessageSpec::objectPrev);
+	unchain(specIndex[ms->hash() & indexMask()], ms, &MessageSpec::specNext, &MessageSpec::specPrev);
+}
+
+/*
+ * Double the number of index buckets and re-chain all messages.
+ * If memory is short the existing index is kept: chains get longer but lookups still work.
+ */
+void MessageQueue::growIndex()
+{
+	if(indexBits >= maxIndexBits) {
+		return;
+	}
+
+	unsigned newSize = indexSize() * 2;
+	auto buckets = static_cast<Index*>(calloc(2 * newSize, sizeof(Index)));
+	if(buckets == nullptr) {
+		debug_w("[SSDP] MessageQueue index not resized");
+		return;
+	}
+
+	auto oldIndex = objectIndex;
+	unsigned oldSize = indexSize();
+	objectIndex = buckets;
+	specIndex = buckets + newSize;
+	++indexBits;
+
+	// Every message is on exactly one object chain
+	for(unsigned b = 0; b < oldSize; ++b) {
+		for(auto i = oldIndex[b]; i != none;) {
+			auto p = get(i);
+			i = p->objectNext;
+			push(objectIndex[objectHash(p->m_object) & indexMask()], p, &MessageSpec::objectNext,
+				 &MessageSpec::objectPrev);
+			push(specIndex[p->hash() & indexMask()], p, &MessageSpec::specNext, &MessageSpec::specPrev);
+		}
+	}
+
+	if(oldIndex != initialIndex) {
+		free(oldIndex);
+	}
+}
+
+/*
+ * Return to the initial, empty, index
+ */
+void MessageQueue::resetIndex()
+{
+	if(objectIndex != initialIndex) {
+		free(objectIndex);
+		objectIndex = initialIndex;
+		specIndex = initialIndex + initialIndexSize;
+		indexBits = initialIndexBits;
+	}
+	memset(initialIndex, 0, sizeof(initialIndex));
+}
+
+/*
+ * Move all messages from the current slot at the given level into lower levels.
+ */
+void MessageQueue::cascade(unsigned level)
+{
+	unsigned index = (current >> (wheelBits * level)) & wheelMask;
+	auto i = slots[level][index];
+	slots[level][index] = none;
+	occupied[level] &= ~(1U << index);
+
+	while(i != none) {
+		auto p = get(i);
+		i = p->next;
+		--wheelCount;
+		insert(p);
+	}
+}
+
+/*
+ * Move all messages in the current level 0 slot to the ready list
+ */
+void MessageQueue::expire()
+{
+	unsigned index = current & wheelMask;
+	auto i = slots[0][index];
+	slots[0][index] = none;
+	occupied[0] &= ~(1U << index);
+
+	while(i != none) {
+		auto p = get(i);
+		auto next = p->next;
+		p->slot = readySlot;
+		p->next = none;
+		p->prev = readyTail;
+		if(readyTail == none) {
+			readyHead = i;
+		} else {
+			get(readyTail)->next = i;
+		}
+		readyTail = i;
+		--wheelCount;
+		i = next;
+	}
+}
+
+/*
+ * Process all wheel slots up to and including `now`, skipping over empty ones.
+ */
+void MessageQueue::advance(uint32_t now)
+{
+	constexpr uint32_t resolutionTicks = Timer::Millis::timeToTicks<resolutionMs>();
+
+	while(wheelCount != 0) {
+		uint32_t delta = nextEvent();
+		if(int(now - (current + delta)) < 0) {
+			break;
+		}
+		current += delta;
+		currentTicks += delta * resolutionTicks;
+
+		for(unsigned level = 1; level < wheelLevels; ++level) {
+			if((current & ((1U << (wheelBits * level)) - 1)) != 0) {
+				break;
+			}
+			cascade(level);
+		}
+		expire();
+
+		++current;
+		currentTicks += resolutionTicks;
+	}
+
+	if(int(now - current) >= 0) {
+		currentTicks += (now + 1 - current) * resolutionTicks;
+		current = now + 1;
+	}
+}
+
+/*
+ * Get number of jiffies from `current` until the next slot visit which has work to do.
+ * For higher levels, a slot is visited (cascaded) at the start of its block.
+ */
+uint32_t MessageQueue::nextEvent() const
+{
+	uint32_t next = wheelSpan;
+	for(unsigned level = 0; level < wheelLevels; ++level) {
+		if(occupied[level] == 0) {
+			continue;
+		}
+		unsigned shift = wheelBits * level;
+		// First block at this level which starts at or after current
+		uint32_t block = (current + (1U << shift) - 1) >> shift;
+		auto bits = rotate(occupied[level], block & wheelMask);
+		block += __builtin_ctz(bits);
+		uint32_t delta = (block << shift) - current;
+		if(delta < next) {
+			next = delta;
+		}
+	}
+	return next;
 }
 
 void MessageQueue::setTimer()
 {
-	if(head == nullptr) {
+	if(readyHead == none && wheelCount == 0) {
 		timer.stop();
+		timerSet = false;
 		return;
 	}
 
-	constexpr uint32_t minimumMessageInterval = Timer::Millis::timeToTicks<100>();
-
-	int interval = head->due - Timer::Clock::ticks();
-	if(interval < int(minimumMessageInterval)) {
-		interval = minimumMessageInterval;
+	// Keep messages spaced out, but don't delay wheel maintenance
+	auto now = Timer::Clock::ticks();
+	int interval = 0;
+	if(readyHead == none || isSpaced(*get(readyHead))) {
+		interval = lastDispatchTicks + messageIntervalTicks - now;
+		if(interval > int(messageIntervalTicks)) {
+			// Last dispatch was so long ago the clock has wrapped
+			interval = 0;
+		}
 	}
+	if(readyHead == none) {
+		constexpr uint32_t resolutionTicks = Timer::Millis::timeToTicks<resolutionMs>();
+		uint32_t delta = nextEvent();
+		timerJiffy = current + delta;
+		int ticks = currentTicks + delta * resolutionTicks - now;
+		interval = std::max(ticks, interval);
+	}
+	interval = std::max(interval, int(minimumTimerInterval));
+
 	timer.setInterval(interval);
 	timer.startOnce();
 	timerSet = true;
@@ -131,37 +446,34 @@ void MessageQueue::setTimer()
 
 bool MessageQueue::contains(const MessageSpec& ms) const
 {
-	for(auto p = head; p != nullptr; p = p->next) {
+	for(auto i = specIndex[ms.hash() & indexMask()]; i != none;) {
+		auto p = get(i);
 		if(*p == ms) {
 			return true;
 		}
+		i = p->specNext;
 	}
 
 	return false;
 }
 
-unsigned MessageQueue::remove(void* object)
+unsigned MessageQueue::remove(void* object, MessageTypeMask types)
 {
 	unsigned count{0};
-	MessageSpec* prev = nullptr;
-	auto p = head;
-	while(p != nullptr) {
-		auto next = p->next;
-		if(p->object<void>() == object) {
-			if(p == head) {
-				head = next;
-			} else {
-				prev->next = next;
-			}
-			delete p;
-			++count;
-		} else {
-			prev = p;
+	for(auto i = objectIndex[objectHash(object) & indexMask()]; i != none;) {
+		auto p = get(i);
+		i = p->objectNext;
+		if(p->m_object != object || (types & getMask(p->type())) == 0) {
+			continue;
 		}
-		p = next;
+		unlink(p);
+		unindex(p);
+		delete p;
+		++count;
 	}
 
 	if(count != 0) {
+		itemCount -= count;
 		setTimer();
 	}
 	return count;
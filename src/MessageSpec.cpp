@@ -40,6 +40,30 @@ NotifySubtype getNotifySubtype(const char* subtype)
 	return (n < 0) ? NotifySubtype::OTHER : NotifySubtype(n);
 }
 
+MessageSpec& MessageSpec::operator=(const MessageSpec& ms)
+{
+	if(this == &ms) {
+		return *this;
+	}
+
+	m_object = ms.m_object;
+	m_remoteIp = ms.m_remoteIp;
+	data = ms.data;
+	m_searchKey = ms.m_searchKey;
+#if SSDP_ENABLE_STATS
+	m_received = ms.m_received;
+#endif
+	// Plan state is not copied
+	m_cursor = nullptr;
+	m_start = 0;
+	m_step = 0;
+	m_interval = 0;
+	m_period = 0;
+	m_flags = ms.m_flags & flagReceived;
+	next = MessagePool::none;
+	return *this;
+}
+
 } // namespace SSDP
 
 String toString(SSDP::NotifySubtype subtype)
@@ -0,0 +1,69 @@
+/**
+ * RateLimit.cpp
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "include/Network/SSDP/RateLimit.h"
+#include <algorithm>
+
+namespace SSDP
+{
+void TokenBucket::refill()
+{
+	auto now = Timer::Clock::ticks();
+	auto seconds = RTC.getRtcSeconds();
+	int64_t elapsed = Timer::Millis::ticksToTime(now - lastTicks).time;
+
+	// Tick count may have wrapped during a long idle period, in which case the RTC shows more time has passed
+	uint32_t idle = seconds - lastSeconds;
+	if(idle > elapsed / 1000 + 1) {
+		elapsed = int64_t(idle) * 1000;
+	}
+	if(elapsed == 0) {
+		return;
+	}
+
+	int32_t capacity = int32_t(rate) * 1000;
+	int64_t credit = elapsed * rate;
+	lastSeconds = seconds;
+	if(elapsed >= 1000) {
+		// Fractions of a millisecond no longer matter, but an overdrawn bucket may still not be full
+		lastTicks = now;
+	} else {
+		// Advance by whole milliseconds only so fractions aren't lost
+		lastTicks += Timer::Millis::timeToTicks(uint32_t(elapsed));
+	}
+	level = int32_t(std::min(level + credit, int64_t(capacity)));
+}
+
+uint32_t TokenBucket::wait(uint16_t tokens)
+{
+	if(rate == 0) {
+		return 0;
+	}
+
+	refill();
+	int32_t required = int32_t(tokens) * 1000;
+	if(level >= required) {
+		return 0;
+	}
+
+	// Level increases by `rate` each millisecond
+	return (required - level + rate - 1) / rate;
+}
+
+} // namespace SSDP
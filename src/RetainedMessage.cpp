@@ -0,0 +1,164 @@
+/**
+ * RetainedMessage.cpp
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "debug.h"
+#include "include/Network/SSDP/RetainedMessage.h"
+
+namespace SSDP
+{
+bool RetainedMessage::assign(const BasicMessage& msg)
+{
+	clear();
+
+	type = msg.type;
+	remoteIP = msg.remoteIP;
+	remotePort = msg.remotePort;
+
+	auto headerCount = msg.count();
+	if(headerCount > maxHeaders) {
+		debug_e("[SSDP] Message has too many headers to retain");
+		return false;
+	}
+
+	size_t textSize{0};
+	for(unsigned i = 0; i < headerCount; ++i) {
+		auto& header = msg[i];
+		textSize += strlen(header.name) + strlen(header.value) + 2;
+	}
+
+	size_t size = sizeof(Block) + headerCount * 2 * sizeof(uint16_t) + textSize;
+	if(size > 0xffff) {
+		debug_e("[SSDP] Message too large to retain");
+		return false;
+	}
+
+	block = static_cast<Block*>(malloc(size));
+	if(block == nullptr) {
+		return false;
+	}
+
+	block->size = size;
+	block->count = headerCount;
+	memset(block->slots, noHeader, sizeof(block->slots));
+
+	auto offs = const_cast<uint16_t*>(offsets());
+	auto txt = const_cast<char*>(text());
+	uint16_t pos{0};
+	auto append = [&](const char* s) -> uint16_t {
+		auto start = pos;
+		auto len = strlen(s) + 1;
+		memcpy(&txt[pos], s, len);
+		pos += len;
+		return start;
+	};
+
+	for(unsigned i = 0; i < headerCount; ++i) {
+		auto& header = msg[i];
+		offs[i * 2] = append(header.name);
+		offs[i * 2 + 1] = append(header.value);
+
+		auto id = getHeaderId(header.name);
+		if(id != HeaderId::MAX && block->slots[unsigned(id)] == noHeader) {
+			block->slots[unsigned(id)] = i;
+		}
+	}
+
+	return true;
+}
+
+RetainedMessage& RetainedMessage::operator=(const RetainedMessage& other)
+{
+	if(this == &other) {
+		return *this;
+	}
+
+	clear();
+	type = other.type;
+	remoteIP = other.remoteIP;
+	remotePort = other.remotePort;
+
+	// Content uses offsets so can be copied directly
+	if(other.block != nullptr) {
+		block = static_cast<Block*>(malloc(other.block->size));
+		if(block != nullptr) {
+			memcpy(block, other.block, other.block->size);
+		}
+	}
+
+	return *this;
+}
+
+RetainedMessage& RetainedMessage::operator=(RetainedMessage&& other)
+{
+	if(this != &other) {
+		clear();
+		type = other.type;
+		remoteIP = other.remoteIP;
+		remotePort = other.remotePort;
+		block = other.block;
+		other.block = nullptr;
+	}
+	return *this;
+}
+
+void RetainedMessage::clear()
+{
+	free(block);
+	block = nullptr;
+}
+
+RetainedMessage::Header RetainedMessage::operator[](unsigned i) const
+{
+	if(i >= count()) {
+		return Header{nullptr, nullptr};
+	}
+
+	auto offs = offsets();
+	auto txt = text();
+	return Header{&txt[offs[i * 2]], &txt[offs[i * 2 + 1]]};
+}
+
+const char* RetainedMessage::operator[](const char* name) const
+{
+	if(name == nullptr || block == nullptr) {
+		return nullptr;
+	}
+
+	auto offs = offsets();
+	auto txt = text();
+	for(unsigned i = 0; i < count(); ++i) {
+		if(strcasecmp(&txt[offs[i * 2]], name) == 0) {
+			return &txt[offs[i * 2 + 1]];
+		}
+	}
+
+	return nullptr;
+}
+
+const char* RetainedMessage::operator[](HeaderId id) const
+{
+	if(block == nullptr || id >= HeaderId::MAX) {
+		return nullptr;
+	}
+
+	auto i = block->slots[unsigned(id)];
+	return (i == noHeader) ? nullptr : &text()[offsets()[i * 2 + 1]];
+}
+
+} // namespace SSDP
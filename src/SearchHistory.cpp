@@ -0,0 +1,80 @@
+/**
+ * SearchHistory.cpp
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "include/Network/SSDP/SearchHistory.h"
+#include <Timer.h>
+
+namespace
+{
+// FNV-1a
+uint32_t hashString(const char* s)
+{
+	uint32_t hash{2166136261U};
+	if(s != nullptr) {
+		while(*s != '\0') {
+			hash = (hash ^ uint8_t(*s++)) * 16777619U;
+		}
+	}
+	return hash;
+}
+
+} // namespace
+
+namespace SSDP
+{
+bool SearchHistory::check(const BasicMessage& msg)
+{
+	if(windowMs == 0) {
+		return false;
+	}
+
+	auto mx = msg[HeaderId::mx];
+	Entry e{};
+	e.ip = uint32_t(msg.remoteIP);
+	e.port = msg.remotePort;
+	e.stHash = hashString(msg[HeaderId::st]);
+	e.mx = mx ? atoi(mx) : 0;
+	e.timestamp = Timer::Clock::ticks();
+	e.used = true;
+
+	uint32_t hash = e.stHash ^ e.ip ^ (e.port << 8) ^ e.mx;
+	hash ^= hash >> 16;
+	hash ^= hash >> 8;
+	auto& entry = entries[hash % capacity];
+
+	bool duplicate = entry.used && entry.ip == e.ip && entry.port == e.port && entry.stHash == e.stHash &&
+					 entry.mx == e.mx && (e.timestamp - entry.timestamp) < Timer::Millis::timeToTicks(windowMs);
+	if(duplicate) {
+		// Leave the original timestamp so a persistent repeater is only suppressed until the window expires
+		++suppressCount;
+		return true;
+	}
+	entry = e;
+	return false;
+}
+
+void SearchHistory::clear()
+{
+	for(auto& e : entries) {
+		e = Entry{};
+	}
+	suppressCount = 0;
+}
+
+} // namespace SSDP
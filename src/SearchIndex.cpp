@@ -0,0 +1,267 @@
+/**
+ * SearchIndex.cpp
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "debug.h"
+#include "include/Network/SSDP/SearchIndex.h"
+#include <algorithm>
+
+namespace
+{
+/*
+ * Plan cursor layout:
+ *
+ *	bits 0-7	Next entry to examine
+ *	bits 8-15	Bucket being examined
+ *	bit 30		Enumerate all entries (ssdp:all)
+ *	bit 31		Always set, so a cursor is never nullptr
+ *
+ * The key to match is held in the plan's `SearchKey`. Only the bucket chain for that key is walked,
+ * or for ssdp:all each chain in turn. Chains are kept in table order and the cursor records
+ * a table position rather than a link, so removing entries whilst a plan is in progress does not affect it.
+ */
+constexpr uint32_t cursorAll{1U << 30};
+constexpr uint32_t cursorValid{1U << 31};
+
+void* makeCursor(unsigned bucket, unsigned pos, bool all)
+{
+	uint32_t c = cursorValid | ((bucket & 0xff) << 8) | (pos & 0xff);
+	if(all) {
+		c |= cursorAll;
+	}
+	return reinterpret_cast<void*>(uintptr_t(c));
+}
+
+SSDP::SearchMatch getMatch(Urn::Kind kind)
+{
+	switch(kind) {
+	case Urn::Kind::root:
+		return SSDP::SearchMatch::root;
+	case Urn::Kind::uuid:
+		return SSDP::SearchMatch::uuid;
+	default:
+		return SSDP::SearchMatch::type;
+	}
+}
+
+} // namespace
+
+namespace SSDP
+{
+SearchIndex::SearchIndex()
+{
+	memset(buckets, none, sizeof(buckets));
+}
+
+bool SearchIndex::add(const Urn& urn, void* object)
+{
+	if(object == nullptr || !urn) {
+		return false;
+	}
+
+	/*
+	 * Only the domain and type strings are indexed, so the UUID need not be in standard form.
+	 * UPnP 1.0 doesn't specify one.
+	 */
+	Entry e;
+	e.object = object;
+	e.kind = urn.kind;
+	if(urn.kind == Urn::Kind::device || urn.kind == Urn::Kind::service) {
+		e.domain = UrnStrings::intern(urn.domain.c_str(), urn.domain.length());
+		e.type = UrnStrings::intern(urn.type.c_str(), urn.type.length());
+		if(e.domain == UrnStrings::none || e.type == UrnStrings::none) {
+			debug_w("[SSDP] Cannot index '%s'", urn.toString().c_str());
+			return false;
+		}
+		e.version = urn.version;
+	}
+
+	auto bucket = getBucket(e);
+	for(auto i = buckets[bucket]; i != none; i = entries[i].next) {
+		auto& entry = entries[i];
+		if(entry.object == object && entry.sameKey(e)) {
+			entry.version = e.version;
+			return true;
+		}
+	}
+
+	for(unsigned i = 0; i < capacity; ++i) {
+		auto& entry = entries[i];
+		if(entry.object != nullptr) {
+			continue;
+		}
+		// Keep chain in table order
+		auto link = &buckets[bucket];
+		while(*link < i) {
+			link = &entries[*link].next;
+		}
+		entry = e;
+		entry.next = *link;
+		*link = i;
+		++itemCount;
+		return true;
+	}
+
+	debug_w("[SSDP] Search index full");
+	return false;
+}
+
+void SearchIndex::remove(void* object)
+{
+	if(object == nullptr) {
+		return;
+	}
+
+	for(auto& head : buckets) {
+		auto link = &head;
+		while(*link != none) {
+			auto& entry = entries[*link];
+			if(entry.object == object) {
+				*link = entry.next;
+				entry = Entry{};
+				--itemCount;
+			} else {
+				link = &entry.next;
+			}
+		}
+	}
+}
+
+void SearchIndex::clear()
+{
+	for(auto& e : entries) {
+		e = Entry{};
+	}
+	memset(buckets, none, sizeof(buckets));
+	itemCount = 0;
+}
+
+unsigned SearchIndex::find(const char* st, MessageSpec& plan) const
+{
+	if(st == nullptr || itemCount == 0) {
+		return 0;
+	}
+
+	if(SSDP_ALL.equals(st)) {
+		plan.setTarget(SearchTarget::all);
+		plan.setCursor(makeCursor(0, 0, true));
+		return itemCount;
+	}
+
+	UrnView view(st);
+	Entry key;
+	key.kind = view.kind;
+	SearchTarget target;
+	switch(view.kind) {
+	case Urn::Kind::root:
+		target = SearchTarget::root;
+		break;
+	case Urn::Kind::device:
+	case Urn::Kind::service:
+		// If strings have never been registered then nothing can match
+		key.domain = UrnStrings::find(view.domain.ptr, view.domain.length);
+		key.type = UrnStrings::find(view.type.ptr, view.type.length);
+		if(key.domain == UrnStrings::none || key.type == UrnStrings::none) {
+			return 0;
+		}
+		key.version = view.version;
+		target = SearchTarget::type;
+		break;
+	default:
+		return 0;
+	}
+
+	auto bucket = getBucket(key);
+	unsigned first{capacity};
+	unsigned count{0};
+	for(auto i = buckets[bucket]; i != none; i = entries[i].next) {
+		if(entries[i].matches(key)) {
+			first = std::min(first, unsigned(i));
+			++count;
+		}
+	}
+
+	if(count != 0) {
+		SearchKey searchKey;
+		searchKey.kind = uint8_t(key.kind);
+		searchKey.domain = key.domain;
+		searchKey.type = key.type;
+		searchKey.version = key.version;
+		plan.setTarget(target);
+		plan.setSearchKey(searchKey);
+		plan.setCursor(makeCursor(bucket, first, false));
+	}
+	return count;
+}
+
+bool SearchIndex::scan(const MessageSpec& plan, unsigned& bucket, unsigned& pos) const
+{
+	auto c = uint32_t(uintptr_t(plan.cursor<void>()));
+	if((c & cursorValid) == 0) {
+		return false;
+	}
+
+	bool all = (c & cursorAll) != 0;
+	auto& searchKey = plan.searchKey();
+	Entry key;
+	key.kind = searchKey.getKind();
+	key.domain = searchKey.domain;
+	key.type = searchKey.type;
+	key.version = searchKey.version;
+
+	bucket = (c >> 8) & 0xff;
+	pos = c & 0xff;
+	for(; bucket < bucketCount; ++bucket, pos = 0) {
+		for(auto i = buckets[bucket]; i != none; i = entries[i].next) {
+			if(i >= pos && (all || entries[i].matches(key))) {
+				pos = i;
+				return true;
+			}
+		}
+		if(!all) {
+			break;
+		}
+	}
+	return false;
+}
+
+bool SearchIndex::next(MessageSpec& plan, MessageSpec& ms) const
+{
+	unsigned bucket;
+	unsigned pos;
+	if(!scan(plan, bucket, pos)) {
+		return false;
+	}
+
+	bool all = (uint32_t(uintptr_t(plan.cursor<void>())) & cursorAll) != 0;
+	auto& entry = entries[pos];
+	plan.setCursor(makeCursor(bucket, pos + 1, all));
+	ms = MessageSpec(plan, getMatch(entry.kind), entry.object);
+	if(all) {
+		// Each response is for a different URN, which also keeps their cached templates apart
+		SearchKey key;
+		key.kind = uint8_t(entry.kind);
+		key.domain = entry.domain;
+		key.type = entry.type;
+		key.version = entry.version;
+		ms.setSearchKey(key);
+	}
+	return true;
+}
+
+} // namespace SSDP
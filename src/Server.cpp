@@ -23,6 +23,8 @@
 #include <SystemClock.h>
 #include <Timer.h>
 #include <Platform/Station.h>
+#include <esp_system.h>
+#include <algorithm>
 
 namespace SSDP
 {
@@ -31,6 +33,12 @@ DEFINE_FSTR(defaultProductNameAndVersion, "SSDP/1.0")
 
 Server server;
 
+uint8_t Server::nextInstance()
+{
+	static uint8_t count;
+	return count++;
+}
+
 String getServerId(const String& productNameAndVersion)
 {
 	String s;
@@ -40,16 +48,61 @@ String getServerId(const String& productNameAndVersion)
 	return s;
 }
 
+/*
+ * Get length of message text, which may span a chain of buffers.
+ * Any NUL terminates the text.
+ */
+static size_t getTextLength(const pbuf* buf)
+{
+	size_t len{0};
+	for(auto p = buf; p != nullptr; p = p->next) {
+		auto nul = memchr(p->payload, '\0', p->len);
+		if(nul != nullptr) {
+			return len + (static_cast<const char*>(nul) - static_cast<const char*>(p->payload));
+		}
+		len += p->len;
+		if(len >= buf->tot_len) {
+			break;
+		}
+	}
+	return len;
+}
+
+bool Server::UdpOut::bind()
+{
+	/*
+	 * UdpConnection only creates its PCB in listen() or connect(), so sending from a connection
+	 * which has never been bound gives "udp_sendto: invalid pcb". We bind once to an ephemeral port
+	 * and keep it: responses to our M-SEARCH requests are sent back to this port.
+	 */
+	if(!bound) {
+		bound = listen(0);
+		if(!bound) {
+			debug_e("[SSDP] Failed to bind outbound connection");
+		}
+	}
+	return bound;
+}
+
+void Server::UdpOut::end()
+{
+	close();
+	bound = false;
+}
+
 void Server::UdpOut::onReceive(pbuf* buf, IpAddress remoteIP, uint16_t remotePort)
 {
-	server.onReceive(buf, remoteIP, remotePort);
+	owner.onReceive(buf, remoteIP, remotePort);
 }
 
 void Server::onReceive(pbuf* buf, IpAddress remoteIP, uint16_t remotePort)
 {
+	SSDP_TRACE(getInstance(), receive, 0, buf->tot_len, uint32_t(remoteIP));
+
 	// Block access from remote networks, or if connected via AP
 	if(!WifiStation.isLocal(remoteIP)) {
 		debug_w("[SSDP] Ignoring external message from %s", remoteIP.toString().c_str());
+		drop(DropReason::nonLocal, remoteIP);
 		return;
 	}
 
@@ -62,11 +115,7 @@ void Server::onReceive(pbuf* buf, IpAddress remoteIP, uint16_t remotePort)
 	 * All except the first 101 characters are NUL, so determine the
 	 * actual length before de-serialisation.
 	 */
-	size_t len = buf->len;
-	auto p = memchr(buf->payload, '\0', len);
-	if(p != nullptr) {
-		len = static_cast<char*>(p) - static_cast<char*>(buf->payload);
-	}
+	size_t len = getTextLength(buf);
 
 #if DEBUG_VERBOSE_LEVEL >= WARN
 	String addr;
@@ -80,42 +129,379 @@ void Server::onReceive(pbuf* buf, IpAddress remoteIP, uint16_t remotePort)
 	}
 
 	if(len == 0) {
+		drop(DropReason::empty, remoteIP);
+		return;
+	}
+
+	/*
+	 * Text contained within the first segment is parsed in-place.
+	 * If it spans a chain of buffers then it must be gathered for parsing.
+	 */
+	if(len <= buf->len) {
+		handleMessage(static_cast<char*>(buf->payload), len, remoteIP, remotePort);
+		return;
+	}
+
+	if(len > maxReceiveSize) {
+		debug_w("[SSDP] RX %s, message too large (%u chars)", addr.c_str(), len);
+		drop(DropReason::tooLarge, remoteIP);
+		return;
+	}
+
+	handleChain(buf, len, remoteIP, remotePort);
+}
+
+/*
+ * BasicHttpHeaders parses in place so text spanning several segments must be made contiguous.
+ * This is the one case where received text is copied: it is gathered into a single network buffer
+ * as the callback stack is too small to hold it.
+ */
+void Server::handleChain(pbuf* buf, size_t len, IpAddress remoteIP, uint16_t remotePort)
+{
+	auto gathered = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+	if(gathered == nullptr) {
+		debug_w("[SSDP] RX %s, no buffer for %u chars", remoteIP.toString().c_str(), len);
+		drop(DropReason::noMemory, remoteIP);
+		return;
+	}
+
+	pbuf_copy_partial(buf, gathered->payload, len, 0);
+	handleMessage(static_cast<char*>(gathered->payload), len, remoteIP, remotePort);
+	pbuf_free(gathered);
+}
+
+/*
+ * Identify message type from the start line without parsing
+ */
+static bool getMessageType(const char* data, size_t len, MessageType& type)
+{
+	auto match = [&](const char* tag, size_t tagLen) { return len > tagLen && memcmp(data, tag, tagLen) == 0; };
+
+	if(match("M-SEARCH ", 9)) {
+		type = MessageType::msearch;
+	} else if(match("NOTIFY ", 7)) {
+		type = MessageType::notify;
+	} else if(match("HTTP/1.", 7)) {
+		type = MessageType::response;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Locate value of a header in raw message text without parsing
+ */
+static const char* findHeader(const char* data, size_t len, const char* name, size_t& valueLen)
+{
+	auto nameLen = strlen(name);
+	auto end = data + len;
+	auto line = static_cast<const char*>(memchr(data, '\n', len));
+	while(line != nullptr && ++line < end) {
+		auto eol = static_cast<const char*>(memchr(line, '\n', end - line));
+		auto lineEnd = eol ?: end;
+		if(lineEnd - line > int(nameLen) && strncasecmp(line, name, nameLen) == 0) {
+			auto p = line + nameLen;
+			while(p < lineEnd && *p == ' ') {
+				++p;
+			}
+			if(p < lineEnd && *p == ':') {
+				++p;
+				while(p < lineEnd && *p == ' ') {
+					++p;
+				}
+				auto q = lineEnd;
+				while(q > p && (q[-1] == '\r' || q[-1] == ' ')) {
+					--q;
+				}
+				valueLen = q - p;
+				return p;
+			}
+		}
+		line = eol;
+	}
+	return nullptr;
+}
+
+/*
+ * Search targets which may match any device, regardless of its type
+ */
+static bool isGenericTarget(const char* value, size_t len)
+{
+	auto match = [&](const char* tag, size_t tagLen) { return len >= tagLen && memcmp(value, tag, tagLen) == 0; };
+
+	return (len == 8 && match("ssdp:all", 8)) || (len == 15 && match("upnp:rootdevice", 15)) || match("uuid:", 5);
+}
+
+bool Server::accept(const char* data, size_t len)
+{
+	MessageType type;
+	if(!getMessageType(data, len, type)) {
+		// Leave it to the parser to report errors
+		return true;
+	}
+
+	if((acceptTypes & getMask(type)) == 0) {
+		return false;
+	}
+
+	if(!acceptPrefix) {
+		return true;
+	}
+
+	size_t valueLen;
+	auto value = findHeader(data, len, (type == MessageType::notify) ? "NT" : "ST", valueLen);
+	if(value == nullptr) {
+		return false;
+	}
+	if(type == MessageType::msearch && isGenericTarget(value, valueLen)) {
+		return true;
+	}
+	auto prefixLen = acceptPrefix.length();
+	return valueLen >= prefixLen && memcmp(value, acceptPrefix.c_str(), prefixLen) == 0;
+}
+
+void Server::receive(char* data, size_t len, IpAddress remoteIP, uint16_t remotePort)
+{
+	SSDP_TRACE(getInstance(), receive, 0, std::min<size_t>(len, 0xffff), uint32_t(remoteIP));
+
+	auto nul = memchr(data, '\0', len);
+	if(nul != nullptr) {
+		len = static_cast<char*>(nul) - data;
+	}
+
+	if(len == 0) {
+		drop(DropReason::empty, remoteIP);
+		return;
+	}
+
+	handleMessage(data, len, remoteIP, remotePort);
+}
+
+void Server::handleMessage(char* data, size_t len, IpAddress remoteIP, uint16_t remotePort)
+{
+	SSDP_STAT(auto receiveTicks = Timer::Clock::ticks());
+
+	if(!accept(data, len)) {
+		drop(DropReason::filtered, remoteIP);
 		return;
 	}
 
 #if DEBUG_VERBOSE_LEVEL == DBG
-	m_nputs(static_cast<const char*>(buf->payload), len);
+	m_nputs(data, len);
 	m_putc('\n');
 #endif
 
 	BasicMessage msg;
-	HttpError err = msg.parse(static_cast<char*>(buf->payload), len);
+	HttpError err = msg.parse(data, len);
+	SSDP_TRACE(getInstance(), parse, uint8_t(msg.type), err, msg.count());
 	if(err != HPE_OK) {
 		debug_e("[SSDP] errno: %u, %s (%u headers)", err, toString(err).c_str(), msg.count());
+		SSDP_STAT(stats.parseError(err));
 		return;
 	}
 
 	msg.remoteIP = remoteIP;
 	msg.remotePort = remotePort;
+	SSDP_STAT(++stats.rx[unsigned(msg.type)]);
+
+	debug_d("[SSDP] RX %s:%u %s: %u headers", remoteIP.toString().c_str(), remotePort, toString(msg.type).c_str(),
+			msg.count());
+
+	if(msg.type == MessageType::msearch && searchHistory.check(msg)) {
+		debug_d("[SSDP] Ignoring duplicate M-SEARCH");
+		drop(DropReason::duplicate, remoteIP);
+		return;
+	}
 
-	debug_d("[SSDP] RX %s %s: %u headers", addr.c_str(), toString(msg.type).c_str(), msg.count());
+	// Responses queued while handling a search count towards response latency
+	SSDP_STAT(messageQueue.setReceiveTime(receiveTicks));
 
-	receiveDelegate(msg);
+	if(msg.type == MessageType::msearch && search(msg)) {
+		SSDP_STAT(messageQueue.clearReceiveTime());
+		return;
+	}
+
+	if(receiveDelegate) {
+		receiveDelegate(msg);
+	}
+
+	SSDP_STAT(messageQueue.clearReceiveTime());
 }
 
 /*
- * Called after device has filled in headers.
+ * Respond directly to searches for registered devices and URNs
  */
-static bool formatMessage(String& data, const Message& msg)
+bool Server::search(const BasicMessage& msg)
 {
-	DEFINE_FSTR_LOCAL(fstr_RESPONSE, "HTTP/1.1 200 OK\r\n");
-	DEFINE_FSTR_LOCAL(fstr_NOTIFY, "NOTIFY");
-	DEFINE_FSTR_LOCAL(fstr_MSEARCH, "M-SEARCH");
-	DEFINE_FSTR_LOCAL(fstr_HTTP, " * HTTP/1.1\r\n");
+	if(devices.count() == 0 && searchIndex.count() == 0) {
+		return false;
+	}
 
-	data.reserve(512);
+	auto st = msg[HeaderId::st];
+	if(st == nullptr) {
+		return false;
+	}
+
+	// Respond at a random point within MX seconds
+	unsigned maxDelay = msg.getMaxWait() * 1000U;
+
+	MessageSpec response(MessageType::response, SearchTarget::all, &searchIndex);
+	response.setRemote(msg.remoteIP, msg.remotePort);
+
+	if(strncmp(st, "uuid:", 5) == 0) {
+		Uuid uuid;
+		auto object = uuid.decompose(st + 5) ? devices.find(uuid) : nullptr;
+		if(object == nullptr) {
+			return false;
+		}
+		response.setTarget(SearchTarget::uuid);
+		auto ms = new MessageSpec(response, SearchMatch::uuid, object);
+		if(ms == nullptr) {
+			return false;
+		}
+		messageQueue.add(ms, os_random() % maxDelay);
+		debug_d("[SSDP] Queued response for %s", st);
+		return true;
+	}
+
+	// One queue entry produces all responses, each at a random point within its own slot of the MX period
+	auto plan = new MessageSpec(response);
+	if(plan == nullptr) {
+		return false;
+	}
+	auto count = searchIndex.find(st, *plan);
+	if(count == 0) {
+		delete plan;
+		return false;
+	}
+	auto slot = std::max(maxDelay / count, 1U);
+	plan->setRandomFanOut(slot, maxDelay, Timer::Clock::ticks());
+	queueRandomFanOut(plan);
+	debug_d("[SSDP] Queued %u responses for %s", count, st);
+	return true;
+}
+
+bool Server::addSearchTarget(const Urn& urn, void* object)
+{
+	if(urn.kind != Urn::Kind::uuid) {
+		return searchIndex.add(urn, object);
+	}
+
+	Uuid uuid;
+	if(!uuid.decompose(urn.uuid)) {
+		debug_e("[SSDP] Invalid device UUID '%s'", urn.uuid.c_str());
+		return false;
+	}
+
+	// Device may already be registered, in which case restore it on failure
+	auto previous = devices.find(uuid);
+	if(!devices.add(uuid, object)) {
+		return false;
+	}
+
+	if(searchIndex.add(urn, object)) {
+		return true;
+	}
+
+	if(previous == nullptr) {
+		devices.remove(uuid);
+	} else {
+		devices.add(uuid, previous);
+	}
+	return false;
+}
+
+void Server::removeSearchTargets(void* object)
+{
+	// Search plans in progress skip removed entries, but single responses refer to the object directly
+	messageQueue.remove(object, getMask(MessageType::response));
+	searchIndex.remove(object);
+	devices.remove(object);
+	templates.invalidate(object);
+}
+
+namespace
+{
+/*
+ * Writes message text into a fixed-size buffer.
+ * Output which doesn't fit is discarded and the overflow flag set.
+ */
+class MessageWriter : public Print
+{
+public:
+	MessageWriter(char* buffer, size_t size) : buffer(buffer), size(size)
+	{
+	}
+
+	using Print::write;
+
+	size_t write(uint8_t c) override
+	{
+		return write(&c, 1);
+	}
+
+	size_t write(const uint8_t* data, size_t len) override
+	{
+		if(len > size - pos) {
+			overflow = true;
+			return 0;
+		}
+		memcpy(&buffer[pos], data, len);
+		pos += len;
+		return len;
+	}
+
+	size_t length() const
+	{
+		return pos;
+	}
+
+	bool overflowed() const
+	{
+		return overflow;
+	}
+
+private:
+	char* buffer;
+	size_t size;
+	size_t pos{0};
+	bool overflow{false};
+};
+
+/*
+ * Get a buffer suitable for sending a single datagram
+ */
+pbuf* allocateBuffer()
+{
+	auto buf = pbuf_alloc(PBUF_TRANSPORT, maxMessageSize, PBUF_RAM);
+	if(buf == nullptr) {
+		debug_e("[SSDP] Out of buffers");
+	}
+	return buf;
+}
+
+/*
+ * Get the ST value a response must echo, if it differs from what the application provides.
+ * Type searches may be answered by a later version than the one requested.
+ */
+String getEchoTarget(const MessageSpec& ms)
+{
+	auto& key = ms.searchKey();
+	if(ms.type() != MessageType::response || ms.match() != SearchMatch::type || key.version == 0) {
+		return nullptr;
+	}
+	return key.toUrn().toString();
+}
+
+/*
+ * Called after device has filled in headers.
+ * If `st` is set it replaces the value of any ST header.
+ */
+bool formatMessage(MessageWriter& writer, const Message& msg, const String& st)
+{
 	if(msg.type == MessageType::response) {
-		data = fstr_RESPONSE;
+		writer.print(_F("HTTP/1.1 200 OK\r\n"));
 	} else {
 		if(msg.type == MessageType::notify) {
 			// Check subtype has been set
@@ -123,49 +509,200 @@ static bool formatMessage(String& data, const Message& msg)
 				debug_e("[SSDP] NTS field missing");
 				return false;
 			}
-			data = fstr_NOTIFY;
+			writer.print(_F("NOTIFY"));
 		} else if(msg.type == MessageType::msearch) {
-			data = fstr_MSEARCH;
+			writer.print(_F("M-SEARCH"));
 		} else {
 			debug_e("[SSDP] Bad message type");
 			return false;
 		}
-		data += fstr_HTTP;
+		writer.print(_F(" * HTTP/1.1\r\n"));
 	}
 
 	// Append message headers
+	auto stField = st ? msg.fromString(F("ST")) : HttpHeaderFieldName::UNKNOWN;
 	for(unsigned i = 0; i < msg.count(); ++i) {
-		data += msg[i];
+		auto header = msg[i];
+		if(stField != HttpHeaderFieldName::UNKNOWN && header.key() == stField) {
+			writer.print(_F("ST: "));
+			writer.print(st);
+			writer.print("\r\n");
+		} else {
+			header.printTo(writer);
+		}
 	}
 
-	data += "\r\n";
+	writer.print("\r\n");
+
+	if(writer.overflowed()) {
+		debug_e("[SSDP] Message exceeds SSDP_MAX_MESSAGE_SIZE (%u bytes), not sent", maxMessageSize);
+		return false;
+	}
+
+	return true;
+}
+
+} // namespace
+
+bool Server::UdpOut::send(pbuf* buf, IpAddress remoteIP, uint16_t remotePort)
+{
+	if(!bind()) {
+		return false;
+	}
+	ip_addr_t addr = remoteIP;
+	return udp_sendto(udp, buf, &addr, remotePort) == ERR_OK;
+}
+
+bool Server::sendMessage(const Message& msg)
+{
+	auto buf = allocateBuffer();
+	if(buf == nullptr) {
+		SSDP_STAT(++stats.sendFailures);
+		return false;
+	}
+
+	// Responses built from a queued spec echo the requested search target
+	String st;
+	if(dispatching != nullptr && msg.type == dispatching->type()) {
+		st = getEchoTarget(*dispatching);
+	}
+
+	auto data = static_cast<char*>(buf->payload);
+	MessageWriter writer(data, maxMessageSize);
+	if(!formatMessage(writer, msg, st)) {
+		pbuf_free(buf);
+		SSDP_STAT(++stats.sendFailures);
+		return false;
+	}
+	auto len = writer.length();
+	pbuf_realloc(buf, len);
 
 #if DEBUG_VERBOSE_LEVEL == DBG
 	debug_d("[SSDP] TX %s:%u", msg.remoteIP.toString().c_str(), msg.remotePort);
-	m_nputs(data.c_str(), data.length());
+	m_nputs(data, len);
+#endif
+
+	// Keep a copy if this message was built from a queued spec.
+	if(capture != nullptr && msg.type == capture->type()) {
+		templates.store(*capture, String(data, len));
+		capture = nullptr;
+	}
+
+	return sendData(msg.type, msg.remoteIP, msg.remotePort, buf);
+}
+
+bool Server::sendData(MessageType type, IpAddress remoteIP, uint16_t remotePort, pbuf* buf)
+{
+	auto len = buf->tot_len;
+	getRateLimit(remoteIP).consume(len);
+
+	bool ok;
+	if(sendSink) {
+		ok = sendSink(remoteIP, remotePort, static_cast<const char*>(buf->payload), len);
+	} else {
+		ok = out.send(buf, remoteIP, remotePort);
+	}
+	pbuf_free(buf);
+	SSDP_TRACE(getInstance(), send, uint8_t(type), ok ? len : 0, uint32_t(remoteIP));
+
+	if(!ok) {
+		debug_e("[SSDP] send (%s:%u) failed", toString(remoteIP).c_str(), remotePort);
+		SSDP_STAT(++stats.sendFailures);
+		return false;
+	}
+
+#if SSDP_ENABLE_STATS
+	++stats.tx[unsigned(type)];
+	if(dispatching != nullptr && dispatching->hasReceived()) {
+		stats.latency(Timer::Millis::ticksToTime(Timer::Clock::ticks() - dispatching->received()).time);
+	}
+#else
+	(void)type;
 #endif
 
 	return true;
 }
 
-bool Server::sendMessage(const Message& msg)
+bool Server::sendTemplate(const MessageSpec& ms)
 {
-	String data;
-	if(!formatMessage(data, msg)) {
+	using FieldId = TemplateCache::FieldId;
+
+	auto entry = templates.find(ms);
+	if(entry == nullptr) {
 		return false;
 	}
 
-	/*
-	 * If we don't do this, UDP goes pop with "udp_sendto: invalid pcb". Not entirely sure why
-	 * but perhaps we need to bind to a new connection for each message...
-	 */
-	out.listen(0);
+	// If system clock has been set (or unset) since template was created then rebuild it
+	bool haveDate = updateDate();
+	if(haveDate != (entry->getField(FieldId::date) != nullptr)) {
+		return false;
+	}
 
-	if(!out.sendStringTo(msg.remoteIP, msg.remotePort, data)) {
-		debug_e("[SSDP] sendStringTo (%s:%u) failed", toString(msg.remoteIP).c_str(), msg.remotePort);
+	auto buf = allocateBuffer();
+	if(buf == nullptr) {
 		return false;
 	}
 
+	// Copy constant text, substituting current values for variable fields
+	auto data = static_cast<char*>(buf->payload);
+	MessageWriter writer(data, maxMessageSize);
+	auto text = entry->data.c_str();
+	unsigned pos{0};
+	for(unsigned i = 0; i < entry->fieldCount; ++i) {
+		auto& field = entry->fields[i];
+		writer.write(&text[pos], field.offset - pos);
+		pos = field.offset + field.length;
+		switch(field.id) {
+		case FieldId::date:
+			writer.print(date);
+			break;
+		case FieldId::host:
+			writer.print(getDestination(ms));
+			writer.print(':');
+			writer.print(ms.remotePort());
+			break;
+		case FieldId::st: {
+			auto st = getEchoTarget(ms);
+			if(st) {
+				writer.print(st);
+			} else {
+				writer.write(&text[field.offset], field.length);
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	writer.write(&text[pos], entry->data.length() - pos);
+
+	if(writer.overflowed()) {
+		pbuf_free(buf);
+		return false;
+	}
+	auto len = writer.length();
+	pbuf_realloc(buf, len);
+
+	debug_d("[SSDP] TX %s:%u from template", toString(ms.remoteIp()).c_str(), ms.remotePort());
+
+	return sendData(ms.type(), ms.remoteIp(), ms.remotePort(), buf);
+}
+
+/*
+ * The formatted DATE value is kept in `date` and only regenerated when the time in seconds changes
+ */
+bool Server::updateDate()
+{
+	if(!SystemClock.isSet()) {
+		date = nullptr;
+		return false;
+	}
+
+	auto now = SystemClock.now(eTZ_UTC);
+	if(now != dateTime || !date) {
+		dateTime = now;
+		date = DateTime(now).toHTTPDate();
+	}
 	return true;
 }
 
@@ -181,8 +718,7 @@ bool Server::begin(ReceiveDelegate onReceive, SendDelegate onSend)
 		return false;
 	}
 
-	this->receiveDelegate = onReceive;
-	this->sendDelegate = onSend;
+	setDelegates(onReceive, onSend);
 
 	auto localIp = WifiStation.getIP();
 
@@ -199,18 +735,119 @@ bool Server::begin(ReceiveDelegate onReceive, SendDelegate onSend)
 	setMulticast(localIp);
 	setMulticastTtl(multicastTtl);
 
+	out.bind();
+
 	debug_i("[SSDP] Started");
 	active = true;
 	return true;
 }
 
+void Server::dispatch(MessageSpec& ms)
+{
+	// Consulted by sendMessage() to echo ST, and for response latency
+	dispatching = &ms;
+
+	// Without a delegate, only messages already rendered as templates can be sent
+	if(!sendTemplate(ms) && sendDelegate) {
+		SSDP_TRACE(getInstance(), build, uint8_t(ms.type()), uint16_t(ms.match()),
+				   uint32_t(uintptr_t(ms.object<void>())));
+
+		Message msg;
+		if(buildMessage(msg, ms)) {
+			if(TemplateCache::capacity != 0 && TemplateCache::isCacheable(ms)) {
+				capture = &ms;
+			}
+			sendDelegate(msg, ms);
+			capture = nullptr;
+		}
+	}
+
+	dispatching = nullptr;
+}
+
+/*
+ * Defer message if rate limit has been reached
+ */
+bool Server::throttle(MessageSpec* ms)
+{
+	auto wait = getRateLimit(getDestination(*ms)).wait();
+	if(wait == 0) {
+		return false;
+	}
+
+	debug_d("[SSDP] Throttled, deferring %u ms", wait);
+	SSDP_STAT(++stats.throttled);
+	messageQueue.add(ms, wait);
+	return true;
+}
+
+/*
+ * Queue plan to send its next message at a random point within the slot for the current step.
+ * Slots are measured from the start of the plan so that queue rounding and throttling do not
+ * accumulate over the sequence. No message is scheduled after the end of the period.
+ */
+void Server::queueRandomFanOut(MessageSpec* plan)
+{
+	uint32_t slot = plan->fanOutInterval();
+	uint32_t due = plan->step() * slot;
+	if(slot != 0) {
+		due += os_random() % slot;
+	}
+	due = std::min(due, uint32_t(plan->fanOutPeriod()));
+	int wait = plan->fanOutStart() + Timer::Millis::timeToTicks(due) - Timer::Clock::ticks();
+	messageQueue.add(plan, (wait > 0) ? Timer::Millis::ticksToTime(wait).time : 0);
+}
+
+void Server::onFanOut(MessageSpec* plan)
+{
+	MessageSpec ms(*plan, plan->match(), plan->object<void>());
+	bool isSearch = (plan->object<void>() == &searchIndex);
+	bool haveNext;
+	if(isSearch) {
+		haveNext = searchIndex.next(*plan, ms);
+	} else {
+		haveNext = fanOutDelegate && fanOutDelegate(*plan, ms);
+	}
+	if(haveNext) {
+		dispatch(ms);
+		plan->nextStep();
+		// Search plans finish with their last response, other plans when the delegate has nothing more
+		if(!isSearch || searchIndex.hasNext(*plan)) {
+			if(plan->isRandomFanOut()) {
+				queueRandomFanOut(plan);
+			} else {
+				messageQueue.add(plan, plan->fanOutInterval());
+			}
+			return;
+		}
+	}
+
+	// Sequence complete
+	debug_d("[SSDP] Fan-out for %p complete, %u messages", plan->object<void>(), plan->step());
+	plan->restart();
+	if(!plan->shouldRepeat()) {
+		delete plan;
+	} else if(plan->isRandomFanOut()) {
+		plan->setFanOutStart(Timer::Clock::ticks() + Timer::Millis::timeToTicks<1000>());
+		queueRandomFanOut(plan);
+	} else {
+		messageQueue.add(plan, 1000);
+	}
+}
+
 void Server::onMessage(MessageSpec* ms)
 {
-	Message msg;
-	if(buildMessage(msg, *ms)) {
-		sendDelegate(msg, *ms);
+	if(throttle(ms)) {
+		return;
 	}
 
+	if(ms->isFanOut()) {
+		onFanOut(ms);
+		return;
+	}
+
+	dispatch(*ms);
+
 	if(ms->shouldRepeat()) {
 		// Send again
 		messageQueue.add(ms, 1000);
@@ -226,6 +863,7 @@ void Server::end()
 	}
 
 	close();
+	out.end();
 
 	leaveMulticastGroup(multicastIp);
 
@@ -235,11 +873,11 @@ void Server::end()
 bool Server::buildMessage(Message& msg, MessageSpec& ms)
 {
 	msg.type = ms.type();
+	msg.remoteIP = getDestination(ms);
 
 	if(msg.type == MessageType::msearch) {
 		msg["MAN"] = SSDP_DISCOVER;
-		msg["MX"] = "3";
-		msg.remoteIP = multicastIp;
+		msg["MX"] = String(searchMaxWait);
 		msg.remotePort = multicastPort;
 
 		switch(ms.target()) {
@@ -258,8 +896,8 @@ bool Server::buildMessage(Message& msg, MessageSpec& ms)
 			return false;
 		}
 	} else {
-		if(SystemClock.isSet()) {
-			msg[HTTP_HEADER_DATE] = DateTime(SystemClock.now(eTZ_UTC)).toHTTPDate();
+		if(updateDate()) {
+			msg[HTTP_HEADER_DATE] = date;
 		}
 
 		if(msg.type == MessageType::notify) {
@@ -270,7 +908,6 @@ bool Server::buildMessage(Message& msg, MessageSpec& ms)
 			msg["EXT"] = "";
 		}
 
-		msg.remoteIP = ms.remoteIp();
 		msg.remotePort = ms.remotePort();
 		msg[HTTP_HEADER_CACHE_CONTROL] = _F("max-age=1800");
 	}
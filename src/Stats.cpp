@@ -0,0 +1,48 @@
+/**
+ * Stats.cpp
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "include/Network/SSDP/Stats.h"
+#include <FlashString/Vector.hpp>
+
+#if SSDP_ENABLE_STATS
+
+namespace
+{
+#define XX(tag, comment) DEFINE_FSTR_LOCAL(str_drop_##tag, #tag)
+SSDP_DROP_REASON_MAP(XX)
+#undef XX
+
+#define XX(tag, comment) &str_drop_##tag,
+DEFINE_FSTR_VECTOR(dropReasonStrings, FlashString, SSDP_DROP_REASON_MAP(XX))
+#undef XX
+
+} // namespace
+
+namespace SSDP
+{
+constexpr uint16_t Stats::latencyLimits[];
+
+} // namespace SSDP
+
+String toString(SSDP::DropReason reason)
+{
+	return dropReasonStrings[unsigned(reason)];
+}
+
+#endif
@@ -0,0 +1,123 @@
+/**
+ * TemplateCache.cpp
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "debug.h"
+#include "include/Network/SSDP/TemplateCache.h"
+
+namespace
+{
+using SSDP::TemplateCache;
+
+/*
+ * Field names, indexed by FieldId
+ */
+const char* const fieldNames[]{"DATE", "HOST", "ST"};
+static_assert(ARRAY_SIZE(fieldNames) == TemplateCache::maxFields, "Field names out of step with FieldId");
+
+/*
+ * Locate values of fields which are regenerated for each send
+ */
+void findFields(TemplateCache::Entry& entry)
+{
+	entry.fieldCount = 0;
+	auto s = entry.data.c_str();
+	for(auto p = strstr(s, "\r\n"); p != nullptr; p = strstr(p, "\r\n")) {
+		p += 2;
+		for(unsigned id = 0; id < TemplateCache::maxFields; ++id) {
+			auto len = strlen(fieldNames[id]);
+			if(strncasecmp(p, fieldNames[id], len) != 0 || p[len] != ':') {
+				continue;
+			}
+			auto value = p + len + 1;
+			while(*value == ' ') {
+				++value;
+			}
+			auto end = strstr(value, "\r\n");
+			if(end == nullptr) {
+				break;
+			}
+			auto& field = entry.fields[entry.fieldCount++];
+			field.offset = value - s;
+			field.length = end - value;
+			field.id = TemplateCache::FieldId(id);
+			break;
+		}
+		if(entry.fieldCount == TemplateCache::maxFields) {
+			break;
+		}
+	}
+}
+
+} // namespace
+
+namespace SSDP
+{
+const TemplateCache::Entry* TemplateCache::find(const MessageSpec& ms)
+{
+#if SSDP_TEMPLATE_CACHE_SIZE
+	auto key = getKey(ms);
+	for(auto& e : entries) {
+		if(e.object == ms.object<void>() && e.key == key && e.data) {
+			e.lastUsed = ++useCount;
+			return &e;
+		}
+	}
+#endif
+
+	return nullptr;
+}
+
+void TemplateCache::store(const MessageSpec& ms, const String& data)
+{
+#if SSDP_TEMPLATE_CACHE_SIZE
+	// Replace matching entry, or least recently used
+	auto key = getKey(ms);
+	Entry* entry = &entries[0];
+	for(auto& e : entries) {
+		if(e.object == ms.object<void>() && e.key == key) {
+			entry = &e;
+			break;
+		}
+		if(int(e.lastUsed - entry->lastUsed) < 0) {
+			entry = &e;
+		}
+	}
+
+	entry->object = ms.object<void>();
+	entry->key = key;
+	entry->lastUsed = ++useCount;
+	entry->data = data;
+	findFields(*entry);
+
+	debug_d("[SSDP] Template stored for %p, %s, %u bytes", entry->object, toString(ms.type()).c_str(), data.length());
+#endif
+}
+
+void TemplateCache::invalidate(void* object)
+{
+#if SSDP_TEMPLATE_CACHE_SIZE
+	for(auto& e : entries) {
+		if(object == nullptr || e.object == object) {
+			e = Entry{};
+		}
+	}
+#endif
+}
+
+} // namespace SSDP
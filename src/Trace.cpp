@@ -0,0 +1,152 @@
+/**
+ * Trace.cpp
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#include "include/Network/SSDP/Trace.h"
+#include <FlashString/Vector.hpp>
+#include <Timer.h>
+
+namespace
+{
+#define XX(tag, a, b, c) DEFINE_FSTR_LOCAL(str_trace_##tag, #tag " " a " " b " " c)
+SSDP_TRACE_EVENT_MAP(XX)
+#undef XX
+
+#define XX(tag, a, b, c) &str_trace_##tag,
+DEFINE_FSTR_VECTOR(traceEventStrings, FlashString, SSDP_TRACE_EVENT_MAP(XX))
+#undef XX
+
+#if SSDP_ENABLE_TRACE
+SSDP::Trace::Entry entries[SSDP::Trace::capacity];
+uint32_t writeCount;
+#endif
+
+} // namespace
+
+namespace SSDP
+{
+void Trace::record(uint8_t instance, Event event, uint8_t a, uint16_t b, uint32_t c)
+{
+#if SSDP_ENABLE_TRACE
+	auto& e = entries[writeCount++ & (capacity - 1)];
+	e.ticks = Timer::Clock::ticks();
+	e.event = event;
+	e.instance = instance;
+	e.a = a;
+	e.b = b;
+	e.c = c;
+#else
+	(void)instance;
+	(void)event;
+	(void)a;
+	(void)b;
+	(void)c;
+#endif
+}
+
+unsigned Trace::read(Entry* buffer, unsigned count)
+{
+#if SSDP_ENABLE_TRACE
+	uint32_t end = writeCount;
+	uint32_t start = (end > capacity) ? end - capacity : 0;
+	if(end - start > count) {
+		start = end - count;
+	}
+	for(auto i = start; i != end; ++i) {
+		*buffer++ = entries[i & (capacity - 1)];
+	}
+	return end - start;
+#else
+	(void)buffer;
+	(void)count;
+	return 0;
+#endif
+}
+
+size_t Trace::dump(Print& p)
+{
+	size_t n{0};
+#if SSDP_ENABLE_TRACE
+	uint32_t end = writeCount;
+	uint32_t start = (end > capacity) ? end - capacity : 0;
+	for(auto i = start; i != end; ++i) {
+		n += p.println(toString(entries[i & (capacity - 1)]));
+	}
+#else
+	(void)p;
+#endif
+	return n;
+}
+
+void Trace::clear()
+{
+#if SSDP_ENABLE_TRACE
+	writeCount = 0;
+#endif
+}
+
+uint32_t Trace::total()
+{
+#if SSDP_ENABLE_TRACE
+	return writeCount;
+#else
+	return 0;
+#endif
+}
+
+} // namespace SSDP
+
+String toString(SSDP::Trace::Event event)
+{
+	String s = traceEventStrings[unsigned(event)];
+	int i = s.indexOf(' ');
+	if(i > 0) {
+		s.setLength(i);
+	}
+	return s;
+}
+
+String toString(const SSDP::Trace::Entry& entry)
+{
+	// e.g. "123456 #0 send type=2 length=310 address=0xfaffffef"
+	String fields = traceEventStrings[unsigned(entry.event)];
+	String s;
+	s += Timer::Micros::ticksToTime(entry.ticks).time;
+	s += " #";
+	s += entry.instance;
+	s += ' ';
+
+	int pos = fields.indexOf(' ');
+	s += fields.substring(0, pos);
+
+	uint32_t values[]{entry.a, entry.b, entry.c};
+	for(auto value : values) {
+		int next = fields.indexOf(' ', pos + 1);
+		auto name = fields.substring(pos + 1, (next < 0) ? fields.length() : unsigned(next));
+		pos = next;
+		if(name == "-") {
+			continue;
+		}
+		s += ' ';
+		s += name;
+		s += '=';
+		s += value;
+	}
+
+	return s;
+}
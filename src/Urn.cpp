@@ -19,64 +19,61 @@
 
 #include "include/Network/SSDP/Urn.h"
 
-/*
- *
- *	none		invalid
- *	uuid		uuid:{uuid}
- *	root		             upnp:rootdevice
- *				uuid:{uuid}::upnp:rootdevice
- *	device		             urn:{domain}:device:{deviceType}:{version}
- *				uuid:{uuid}::urn:{domain}:device:{deviceType}:{version}
- *	service		             urn:{domain}:service:{serviceType}:{version}
- *				uuid:{uuid}::urn:{domain}:service:{serviceType}:{version}
- */
-bool Urn::decompose(const char* s)
+bool UrnView::decompose(const char* s, size_t len)
 {
-	*this = Usn{};
-	auto p = strchr(s, ':');
+	*this = UrnView{};
+	if(s == nullptr) {
+		return false;
+	}
+
+	auto end = s + len;
+	auto findColon = [end](const char* from) -> const char* {
+		return static_cast<const char*>(memchr(from, ':', end - from));
+	};
+	auto slice = [](const char* from, const char* to) -> Slice { return Slice{from, uint16_t(to - from)}; };
+
+	auto p = findColon(s);
 	if(p == nullptr) {
 		return false;
 	}
 
 	if(p - s == 4 && memcmp(s, "uuid", 4) == 0) {
 		s = ++p;
-		p = strchr(s, ':');
+		p = findColon(s);
 		if(p == nullptr) {
 			//	uuid:{uuid}
-			uuid = s;
+			uuid = slice(s, end);
 			kind = Kind::uuid;
 			return true;
 		}
 
-		uuid.setString(s, p - s);
-		s = ++p;
-		if(*s++ != ':') {
+		uuid = slice(s, p);
+		if(p + 1 >= end || p[1] != ':') {
 			return false;
 		}
-		s = ++p;
-
-		p = strchr(s, ':');
+		s = p + 2;
+		p = findColon(s);
 	}
 
-	if(strcmp(s, _F("upnp:rootdevice")) == 0) {
+	if(end - s == 15 && memcmp(s, _F("upnp:rootdevice"), 15) == 0) {
 		kind = Kind::root;
 		return true;
 	}
 
-	if(p - s != 3 || memcmp(s, "urn", 3) != 0) {
+	if(p == nullptr || p - s != 3 || memcmp(s, "urn", 3) != 0) {
 		return false;
 	}
 	s = ++p;
 
-	p = strchr(s, ':');
+	p = findColon(s);
 	if(p == nullptr) {
 		return false;
 	}
 
-	domain.setString(s, p - s);
+	domain = slice(s, p);
 	s = ++p;
 
-	p = strchr(s, ':');
+	p = findColon(s);
 	if(p == nullptr) {
 		return false;
 	}
@@ -91,18 +88,79 @@ bool Urn::decompose(const char* s)
 	}
 	s = ++p;
 
-	p = strchr(s, ':');
+	p = findColon(s);
 	if(p == nullptr) {
 		return false;
 	}
-	type.setString(s, p - s);
+	type = slice(s, p);
 	s = ++p;
 
-	version = atoi(s);
+	unsigned v{0};
+	while(s < end && *s >= '0' && *s <= '9') {
+		v = (v * 10) + (*s++ - '0');
+	}
+	version = v;
 	kind = k;
 	return true;
 }
 
+bool UrnView::operator==(const Urn& urn) const
+{
+	if(kind != urn.kind) {
+		return false;
+	}
+
+	switch(kind) {
+	case Kind::none:
+	case Kind::root:
+		return true;
+	case Kind::uuid:
+		return uuid == urn.uuid;
+	case Kind::device:
+	case Kind::service:
+		return version == urn.version && domain == urn.domain && type == urn.type && uuid == urn.uuid;
+	default:
+		return false;
+	}
+}
+
+Urn UrnView::toUrn() const
+{
+	Urn urn(kind);
+	urn.uuid = uuid.toString();
+	urn.domain = domain.toString();
+	urn.type = type.toString();
+	urn.version = version;
+	return urn;
+}
+
+/*
+ *
+ *	none		invalid
+ *	uuid		uuid:{uuid}
+ *	root		             upnp:rootdevice
+ *				uuid:{uuid}::upnp:rootdevice
+ *	device		             urn:{domain}:device:{deviceType}:{version}
+ *				uuid:{uuid}::urn:{domain}:device:{deviceType}:{version}
+ *	service		             urn:{domain}:service:{serviceType}:{version}
+ *				uuid:{uuid}::urn:{domain}:service:{serviceType}:{version}
+ */
+bool Urn::decompose(const char* s)
+{
+	UrnView view(s);
+	if(!view) {
+		*this = Urn{};
+		return false;
+	}
+
+	kind = view.kind;
+	uuid = view.uuid.toString();
+	domain = view.domain.toString();
+	type = view.type.toString();
+	version = view.version;
+	return true;
+}
+
 String Urn::toString() const
 {
 	if(kind == Kind::none) {
@@ -21,9 +21,30 @@
 #include <cstring>
 #include <Platform/Station.h>
 #include <SystemClock.h>
-#include <stringconversion.h>
 #include <esp_system.h>
 
+namespace
+{
+// Position of each byte within string representation
+const uint8_t digitOffsets[16]{0, 2, 4, 6, 9, 11, 14, 16, 19, 21, 24, 26, 28, 30, 32, 34};
+
+const char hexDigits[]{"0123456789abcdef"};
+
+/*
+ * Returns value of a hex digit (0-15), or a value with upper bits set if invalid
+ */
+uint8_t hexValue(char c)
+{
+	uint8_t d = c - '0';
+	if(d < 10) {
+		return d;
+	}
+	uint8_t x = (c | 0x20) - 'a';
+	return (x < 6) ? (x + 10) : 0xff;
+}
+
+} // namespace
+
 bool Uuid::generate()
 {
 	auto mac = WifiStation.getMacAddress();
@@ -49,42 +70,35 @@ bool Uuid::generate()
 
 bool Uuid::decompose(const char* s, size_t len)
 {
-	if(len != stringSize) {
+	if(s == nullptr || len != stringSize) {
 		return false;
 	}
 
-	char* p;
-	time_low = strtoul(s, &p, 16);
-	if(*p != '-' || p - s != 8) {
+	// 2fac1234-31f8-11b4-a222-08002b34c003
+	if(s[8] != '-' || s[13] != '-' || s[18] != '-' || s[23] != '-') {
 		return false;
 	}
-	s = ++p;
 
-	time_mid = strtoul(s, &p, 16);
-	if(*p != '-' || p - s != 4) {
-		return false;
+	// Any invalid digit sets upper bits, so check once at the end
+	uint8_t bytes[16];
+	uint8_t invalid{0};
+	for(unsigned i = 0; i < sizeof(bytes); ++i) {
+		auto p = &s[digitOffsets[i]];
+		uint8_t hi = hexValue(p[0]);
+		uint8_t lo = hexValue(p[1]);
+		invalid |= hi | lo;
+		bytes[i] = (hi << 4) | lo;
 	}
-	s = ++p;
-
-	time_hi_and_version = strtoul(s, &p, 16);
-	if(*p != '-' || p - s != 4) {
+	if(invalid & 0xf0) {
 		return false;
 	}
-	s = ++p;
 
-	uint16_t x = strtoul(s, &p, 16);
-	if(*p != '-' || p - s != 4) {
-		return false;
-	}
-	clock_seq_hi_and_reserved = x >> 8;
-	clock_seq_low = x & 0xff;
-	s = ++p;
-
-	for(unsigned i = 0; i < sizeof(node); ++i) {
-		uint8_t c = unhex(*s++) << 4;
-		c |= unhex(*s++);
-		node[i] = c;
-	}
+	time_low = (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (bytes[2] << 8) | bytes[3];
+	time_mid = (bytes[4] << 8) | bytes[5];
+	time_hi_and_version = (bytes[6] << 8) | bytes[7];
+	clock_seq_hi_and_reserved = bytes[8];
+	clock_seq_low = bytes[9];
+	memcpy(node, &bytes[10], sizeof(node));
 
 	return true;
 }
@@ -95,32 +109,65 @@ size_t Uuid::toString(char* buffer, size_t bufSize) const
 		return 0;
 	}
 
-	auto set = [&](unsigned offset, uint32_t value, unsigned digits) {
-		ultoa_wp(value, &buffer[offset], 16, digits, '0');
+	uint8_t bytes[16]{
+		uint8_t(time_low >> 24),
+		uint8_t(time_low >> 16),
+		uint8_t(time_low >> 8),
+		uint8_t(time_low),
+		uint8_t(time_mid >> 8),
+		uint8_t(time_mid),
+		uint8_t(time_hi_and_version >> 8),
+		uint8_t(time_hi_and_version),
+		clock_seq_hi_and_reserved,
+		clock_seq_low,
 	};
+	memcpy(&bytes[10], node, sizeof(node));
 
-	// 2fac1234-31f8-11b4-a222-08002b34c003
-	// 0        9    14   19   24          36
-
-	set(0, time_low, 8);
-	buffer[8] = '-';
-	set(9, time_mid, 4);
-	buffer[13] = '-';
-	set(14, time_hi_and_version, 4);
-	buffer[18] = '-';
-	set(19, clock_seq_hi_and_reserved, 2);
-	set(21, clock_seq_low, 2);
-	buffer[23] = '-';
-
-	unsigned pos = 24;
-	for(unsigned i = 0; i < 6; ++i) {
-		buffer[pos++] = hexchar(node[i] >> 4);
-		buffer[pos++] = hexchar(node[i] & 0x0f);
+	for(unsigned i = 0; i < sizeof(bytes); ++i) {
+		auto p = &buffer[digitOffsets[i]];
+		p[0] = hexDigits[bytes[i] >> 4];
+		p[1] = hexDigits[bytes[i] & 0x0f];
 	}
+	buffer[8] = buffer[13] = buffer[18] = buffer[23] = '-';
 
 	return stringSize;
 }
 
+bool Uuid::operator<(const Uuid& other) const
+{
+	// Same ordering as string representation
+	if(time_low != other.time_low) {
+		return time_low < other.time_low;
+	}
+	if(time_mid != other.time_mid) {
+		return time_mid < other.time_mid;
+	}
+	if(time_hi_and_version != other.time_hi_and_version) {
+		return time_hi_and_version < other.time_hi_and_version;
+	}
+	if(clock_seq_hi_and_reserved != other.clock_seq_hi_and_reserved) {
+		return clock_seq_hi_and_reserved < other.clock_seq_hi_and_reserved;
+	}
+	if(clock_seq_low != other.clock_seq_low) {
+		return clock_seq_low < other.clock_seq_low;
+	}
+	return memcmp(node, other.node, sizeof(node)) < 0;
+}
+
+uint32_t Uuid::hash() const
+{
+	uint32_t words[4];
+	memcpy(words, this, sizeof(words));
+	uint32_t h = words[0] ^ (words[1] * 0x9e3779b1U) ^ (words[2] * 0x85ebca77U) ^ (words[3] * 0xc2b2ae3dU);
+	// Murmur3 finaliser
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+	return h;
+}
+
 String Uuid::toString() const
 {
 	String s;
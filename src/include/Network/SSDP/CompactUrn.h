@@ -0,0 +1,151 @@
+/****
+ * CompactUrn.h - Interned URN representation
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include "Urn.h"
+
+/**
+ * @brief Table of interned domain and type strings
+ *
+ * Strings are stored once and referred to by a small integer identifier.
+ * Identifier 0 is reserved for the empty string. Entries are never removed.
+ * Lookup by identifier is direct, and by string via a small hash table.
+ */
+class UrnStrings
+{
+public:
+	using Id = uint8_t;
+
+	static constexpr Id none{0};
+	static constexpr unsigned maxStrings{255};
+
+	/**
+	 * @brief Find an interned string
+	 * @retval Id Identifier, or `none` if not found
+	 */
+	static Id find(const char* s, size_t len);
+
+	/**
+	 * @brief Find an interned string, adding it if not present
+	 * @retval Id Identifier, or `none` if the table is full
+	 */
+	static Id intern(const char* s, size_t len);
+
+	/**
+	 * @brief Get string for an identifier
+	 * @retval const char* nullptr if identifier is invalid
+	 * @note The text is held in a single block which is reallocated as strings are added,
+	 * so the returned pointer is only valid until the next call to `intern()`.
+	 * Copy the text if it must be kept.
+	 */
+	static const char* get(Id id);
+
+	/**
+	 * @brief Number of strings in table
+	 */
+	static unsigned count();
+};
+
+/**
+ * @brief Compact URN using a binary UUID and interned domain and type strings
+ *
+ * Equality and hashing are constant-time operations on integer fields.
+ * Requires UUIDs to be in the standard form managed by `Uuid`: UPnP 1.0 does not
+ * specify a UUID format, so such URNs may not be representable.
+ */
+struct CompactUrn {
+	using Kind = Urn::Kind;
+
+	Uuid uuid;
+	UrnStrings::Id domain{UrnStrings::none};
+	UrnStrings::Id type{UrnStrings::none};
+	Kind kind{};
+	uint8_t version{1};
+
+	CompactUrn()
+	{
+	}
+
+	/**
+	 * @brief Set from a URN, interning domain and type strings as required
+	 * @retval bool false if UUID is not in standard form or string table is full
+	 */
+	bool fromUrn(const Urn& urn)
+	{
+		return set(view(urn), true);
+	}
+
+	bool fromUrn(const UrnView& view)
+	{
+		return set(view, true);
+	}
+
+	/**
+	 * @brief Set from a URN without adding to string table
+	 *
+	 * Use to match incoming search targets: if the domain or type strings are not
+	 * already interned then no stored URN can match.
+	 *
+	 * @retval bool false if URN cannot be represented using existing strings
+	 */
+	bool find(const UrnView& view)
+	{
+		return set(view, false);
+	}
+
+	bool find(const Urn& urn)
+	{
+		return set(view(urn), false);
+	}
+
+	Urn toUrn() const;
+
+	String toString() const
+	{
+		return toUrn().toString();
+	}
+
+	explicit operator String() const
+	{
+		return toString();
+	}
+
+	explicit operator bool() const
+	{
+		return kind != Kind::none;
+	}
+
+	bool operator==(const CompactUrn& other) const
+	{
+		return kind == other.kind && version == other.version && domain == other.domain && type == other.type &&
+			   uuid == other.uuid;
+	}
+
+	bool operator!=(const CompactUrn& other) const
+	{
+		return !operator==(other);
+	}
+
+	uint32_t hash() const;
+
+private:
+	static UrnView view(const Urn& urn);
+	bool set(const UrnView& view, bool intern);
+};
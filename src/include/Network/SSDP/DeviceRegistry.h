@@ -0,0 +1,130 @@
+/****
+ * DeviceRegistry.h - Map device UUIDs to objects
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include "Uuid.h"
+
+#ifndef SSDP_DEVICE_REGISTRY_SIZE
+#define SSDP_DEVICE_REGISTRY_SIZE 8
+#endif
+
+namespace SSDP
+{
+/**
+ * @brief Hash table mapping device UUIDs to objects
+ *
+ * Uses open addressing with linear probing, so there is no per-entry allocation.
+ * Deleted entries are closed up by shifting subsequent entries back, so lookups
+ * do not degrade as devices come and go.
+ *
+ * The table starts with `SSDP_DEVICE_REGISTRY_SIZE` entries held inline and doubles in size,
+ * on the heap, whenever it becomes three-quarters full. This keeps probe chains short
+ * however many devices are registered.
+ */
+class DeviceRegistry
+{
+public:
+	static constexpr size_t initialCapacity{SSDP_DEVICE_REGISTRY_SIZE};
+
+	DeviceRegistry() = default;
+
+	DeviceRegistry(const DeviceRegistry&) = delete;
+
+	~DeviceRegistry()
+	{
+		clear();
+	}
+
+	/**
+	 * @brief Add or update a device
+	 * @param uuid Device UUID
+	 * @param object Object to associate with the device, must not be nullptr
+	 * @retval bool false if registry is full and could not be enlarged
+	 */
+	bool add(const Uuid& uuid, void* object);
+
+	/**
+	 * @brief Remove a device
+	 * @retval bool false if device was not found
+	 */
+	bool remove(const Uuid& uuid);
+
+	/**
+	 * @brief Remove all entries for an object
+	 */
+	void remove(void* object);
+
+	/**
+	 * @brief Find object for a device
+	 * @retval void* nullptr if not found
+	 */
+	void* find(const Uuid& uuid) const;
+
+	/**
+	 * @brief Get number of registered devices
+	 */
+	size_t count() const
+	{
+		return itemCount;
+	}
+
+	/**
+	 * @brief Get current size of table
+	 */
+	size_t capacity() const
+	{
+		return tableSize;
+	}
+
+	/**
+	 * @brief Remove all devices and release any memory allocated for the table
+	 */
+	void clear();
+
+private:
+	struct Entry {
+		Uuid uuid;
+		void* object{nullptr}; ///< nullptr if entry is free
+	};
+
+#if SSDP_DEVICE_REGISTRY_SIZE
+	unsigned home(const Uuid& uuid) const
+	{
+		return uuid.hash() % tableSize;
+	}
+
+	unsigned nextIndex(unsigned i) const
+	{
+		return (i + 1 == tableSize) ? 0 : i + 1;
+	}
+
+	int indexOf(const Uuid& uuid) const;
+	void insert(const Uuid& uuid, void* object);
+	void removeAt(unsigned index);
+	bool grow();
+
+	Entry initialEntries[initialCapacity];
+	Entry* entries{initialEntries};
+#endif
+	size_t tableSize{initialCapacity};
+	size_t itemCount{0};
+};
+
+} // namespace SSDP
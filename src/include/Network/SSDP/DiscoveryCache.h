@@ -0,0 +1,229 @@
+/****
+ * DiscoveryCache.h - Track devices and services advertised on the network
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include "MessageSpec.h"
+#include <Timer.h>
+#include <Delegate.h>
+
+#define SSDP_DISCOVERY_EVENT_MAP(XX)                                                                                   \
+	XX(added, "New USN discovered")                                                                                    \
+	XX(changed, "Location or type changed")                                                                            \
+	XX(removed, "Expired or byebye received")
+
+namespace SSDP
+{
+/**
+ * @brief Cache of advertisements received by a control point
+ *
+ * Feed NOTIFY and M-SEARCH response messages to `update()`. Entries are keyed by USN
+ * and removed when their CACHE-CONTROL max-age elapses or an `ssdp:byebye` is received.
+ *
+ * Entries are stored in a single arena, allocated when the first entry is added. Each one holds
+ * the USN, type (NT or ST) and LOCATION strings. Space used by replaced or removed entries is
+ * reclaimed by compacting the arena when room is required.
+ * Expiry uses one periodic sweep timer, which runs only whilst the cache is not empty.
+ *
+ * Entries are unlinked from the index before the callback is invoked, so the callback may safely
+ * modify the cache.
+ */
+class DiscoveryCache
+{
+public:
+	enum class Event {
+#define XX(tag, comment) tag,
+		SSDP_DISCOVERY_EVENT_MAP(XX)
+#undef XX
+	};
+
+	static constexpr uint16_t defaultMaxAge{1800};
+	static constexpr uint16_t sweepInterval{5};		 ///< Seconds between expiry checks
+	static constexpr uint16_t defaultEntrySize{192}; ///< Arena space per entry if not specified
+
+	class Entry
+	{
+	public:
+		const char* usn() const
+		{
+			return text();
+		}
+
+		const char* type() const
+		{
+			return text() + typeOffset;
+		}
+
+		const char* location() const
+		{
+			return text() + locationOffset;
+		}
+
+		/**
+		 * @brief Get remaining lifetime in seconds (approximate)
+		 */
+		uint32_t expiresIn(uint32_t now) const
+		{
+			return int(expires - now) > 0 ? expires - now : 0;
+		}
+
+	private:
+		friend class DiscoveryCache;
+
+		enum class State : uint8_t {
+			live,	  ///< In the index
+			removing, ///< Unlinked, callback not yet invoked
+			dead,	  ///< Space to be reclaimed
+		};
+
+		const char* text() const
+		{
+			return reinterpret_cast<const char*>(this + 1);
+		}
+
+		char* text()
+		{
+			return reinterpret_cast<char*>(this + 1);
+		}
+
+		uint32_t hash;	 ///< Hash of USN
+		uint32_t expires; ///< Cache time at which entry expires
+		uint16_t size;	 ///< Space occupied in arena, including text
+		uint16_t next;	 ///< Position of next entry in hash bucket
+		uint16_t typeOffset;
+		uint16_t locationOffset;
+		State state;
+	};
+
+	/**
+	 * @brief Callback invoked when cache content changes
+	 * @param event What happened
+	 * @param entry The entry concerned. For `removed` events its space is reclaimed on return.
+	 */
+	using Callback = Delegate<void(Event event, const Entry& entry)>;
+
+	/**
+	 * @param maxEntries Advertisements from new USNs are ignored when the cache is full
+	 * @param arenaSize Bytes of storage for entries, 0 to allow `defaultEntrySize` per entry
+	 */
+	DiscoveryCache(uint16_t maxEntries = 32, uint16_t arenaSize = 0);
+
+	~DiscoveryCache();
+
+	void onEvent(Callback callback)
+	{
+		this->callback = callback;
+	}
+
+	/**
+	 * @brief Process a received message
+	 * @retval bool true if message was a relevant advertisement
+	 */
+	bool update(const BasicMessage& msg);
+
+	/**
+	 * @brief Find an entry
+	 * @retval Entry* nullptr if not found or expired. Valid until the cache is next modified.
+	 */
+	const Entry* find(const char* usn) const;
+
+	/**
+	 * @brief Remove an entry
+	 * @retval bool false if not found
+	 */
+	bool remove(const char* usn);
+
+	/**
+	 * @brief Remove expired entries
+	 *
+	 * Called periodically by the sweep timer.
+	 */
+	void expire();
+
+	/**
+	 * @brief Remove all entries without invoking callback
+	 */
+	void clear();
+
+	unsigned count() const
+	{
+		return itemCount;
+	}
+
+	/**
+	 * @brief Get current cache time, in seconds
+	 */
+	uint32_t now() const
+	{
+		return clock;
+	}
+
+	/**
+	 * @brief Call a function for each entry
+	 */
+	template <typename Function> void forEach(Function func) const
+	{
+		for(unsigned pos = 0; pos < arenaUsed;) {
+			auto e = reinterpret_cast<const Entry*>(arena + pos);
+			if(e->state == Entry::State::live) {
+				func(*e);
+			}
+			pos += e->size;
+		}
+	}
+
+private:
+	static constexpr unsigned bucketCount{16};
+
+	/*
+	 * Links are arena positions + 1, so 0 marks the end of a chain
+	 */
+	Entry* get(uint16_t link) const
+	{
+		return link ? reinterpret_cast<Entry*>(arena + link - 1) : nullptr;
+	}
+
+	uint16_t linkTo(const Entry* e) const
+	{
+		return reinterpret_cast<const uint8_t*>(e) - arena + 1;
+	}
+
+	uint16_t* findLink(const char* usn, uint32_t hash);
+	bool reserve(size_t size);
+	Entry* createEntry(uint32_t hash, const char* usn, const char* type, const char* location);
+	void unlink(uint16_t* link);
+	void notifyRemoved();
+	void compact();
+	void onSweep();
+
+	uint8_t* arena{nullptr};
+	Callback callback;
+	Timer timer;
+	uint32_t clock{0};
+	uint16_t buckets[bucketCount]{};
+	uint16_t arenaSize;
+	uint16_t arenaUsed{0};
+	uint16_t maxEntries;
+	uint16_t itemCount{0};
+	uint8_t busy{0}; ///< Callback nesting depth. Arena is only compacted when zero.
+};
+
+} // namespace SSDP
+
+String toString(SSDP::DiscoveryCache::Event event);
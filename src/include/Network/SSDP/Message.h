@@ -23,16 +23,64 @@
 #include <Network/Http/BasicHttpHeaders.h>
 #include <Network/Http/HttpHeaders.h>
 
+#ifndef SSDP_MAX_MESSAGE_SIZE
+#define SSDP_MAX_MESSAGE_SIZE 1400
+#endif
+
+#ifndef SSDP_MAX_RECEIVE_SIZE
+#define SSDP_MAX_RECEIVE_SIZE 1400
+#endif
+
 #define SSDP_MESSAGE_TYPE_MAP(XX)                                                                                      \
 	XX(notify)                                                                                                         \
 	XX(msearch)                                                                                                        \
 	XX(response)
 
+/**
+ * @brief Well-known SSDP headers which are indexed when a message is parsed
+ */
+#define SSDP_HEADER_MAP(XX)                                                                                            \
+	XX(host, "HOST")                                                                                                   \
+	XX(man, "MAN")                                                                                                     \
+	XX(mx, "MX")                                                                                                       \
+	XX(st, "ST")                                                                                                       \
+	XX(nt, "NT")                                                                                                       \
+	XX(nts, "NTS")                                                                                                     \
+	XX(usn, "USN")                                                                                                     \
+	XX(location, "LOCATION")                                                                                           \
+	XX(cacheControl, "CACHE-CONTROL")                                                                                  \
+	XX(server, "SERVER")                                                                                               \
+	XX(bootId, "BOOTID.UPNP.ORG")                                                                                      \
+	XX(configId, "CONFIGID.UPNP.ORG")                                                                                  \
+	XX(searchPort, "SEARCHPORT.UPNP.ORG")
+
 namespace SSDP
 {
 static const IpAddress multicastIp(239, 255, 255, 250);
 static constexpr uint16_t multicastPort = 1900;
 
+/**
+ * @brief Maximum size of an SSDP message
+ *
+ * Each discovery message must fit entirely in a single UDP packet.
+ * The default suits a typical Ethernet MTU; the spec. notes that some networks
+ * may only carry 512 bytes, in which case this should be reduced.
+ */
+static constexpr size_t maxMessageSize = SSDP_MAX_MESSAGE_SIZE;
+
+/**
+ * @brief Maximum size of a received SSDP message
+ *
+ * Messages from other implementations may be larger than those sent, so this is set separately.
+ */
+static constexpr size_t maxReceiveSize = SSDP_MAX_RECEIVE_SIZE;
+
+/**
+ * @brief Permitted range for M-SEARCH MX values, in seconds
+ */
+static constexpr uint8_t minMaxWait{1};
+static constexpr uint8_t maxMaxWait{5};
+
 DECLARE_FSTR(SSDP_DISCOVER);
 DECLARE_FSTR(UPNP_ROOTDEVICE);
 DECLARE_FSTR(SSDP_ALL);
@@ -43,6 +91,42 @@ enum class MessageType {
 #undef XX
 };
 
+/**
+ * @brief Bitmask of message types
+ */
+using MessageTypeMask = uint8_t;
+
+inline constexpr MessageTypeMask getMask(MessageType type)
+{
+	return 1U << unsigned(type);
+}
+
+static constexpr MessageTypeMask allMessageTypes{
+#define XX(tag) getMask(MessageType::tag) |
+	SSDP_MESSAGE_TYPE_MAP(XX)
+#undef XX
+		0};
+
+enum class HeaderId {
+#define XX(tag, name) tag,
+	SSDP_HEADER_MAP(XX)
+#undef XX
+		MAX
+};
+
+/**
+ * @brief Identify a well-known SSDP header
+ * @param name Header name, case is ignored
+ * @retval HeaderId `HeaderId::MAX` if not recognised
+ */
+HeaderId getHeaderId(const char* name);
+
+/**
+ * @brief Interpret an MX header value
+ * @retval uint8_t Value constrained to the range 1 - 5 seconds
+ */
+uint8_t getMaxWait(const char* mx);
+
 /**
  * @brief class template for messages
  */
@@ -61,7 +145,35 @@ public:
 class BasicMessage : public BaseMessage<BasicHttpHeaders>
 {
 public:
+	using BasicHttpHeaders::operator[];
+
 	HttpError parse(char* data, size_t len);
+
+	/**
+	 * @brief Get value of a well-known header
+	 * @retval const char* nullptr if header is not present
+	 * @note Headers are classified during parsing so this does not need to search.
+	 * Other headers may be obtained by name as usual.
+	 */
+	const char* operator[](HeaderId id) const
+	{
+		return (id < HeaderId::MAX) ? slots[unsigned(id)] : nullptr;
+	}
+
+	/**
+	 * @brief Get maximum wait time for responding to an M-SEARCH request
+	 * @retval uint8_t MX value constrained to the range 1 - 5 seconds
+	 *
+	 * Responses should be delayed by a random time up to this value. The UPnP spec. requires
+	 * larger values be treated as 5; a missing or invalid value is treated as 1.
+	 */
+	uint8_t getMaxWait() const
+	{
+		return SSDP::getMaxWait(operator[](HeaderId::mx));
+	}
+
+private:
+	const char* slots[unsigned(HeaderId::MAX)]{};
 };
 
 /**
@@ -79,3 +191,4 @@ public:
 } // namespace SSDP
 
 String toString(SSDP::MessageType type);
+String toString(SSDP::HeaderId id);
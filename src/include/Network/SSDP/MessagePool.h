@@ -0,0 +1,107 @@
+/****
+ * MessagePool.h - Fixed-capacity storage for MessageSpec objects
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#ifndef SSDP_MESSAGE_POOL_SIZE
+#define SSDP_MESSAGE_POOL_SIZE 16
+#endif
+
+#ifndef SSDP_MESSAGE_POOL_HEAP_FALLBACK
+#define SSDP_MESSAGE_POOL_HEAP_FALLBACK 1
+#endif
+
+namespace SSDP
+{
+/**
+ * @brief Allocator used by `MessageSpec::operator new`
+ *
+ * Scheduled messages are allocated and freed frequently during search bursts.
+ * To avoid fragmenting the heap they are taken from a statically allocated pool
+ * with an intrusive free list. When the pool is exhausted the allocation is either
+ * made from the heap or fails, according to `SSDP_MESSAGE_POOL_HEAP_FALLBACK`.
+ *
+ * Every allocation is identified by a 16-bit index so that queue links need not be full pointers.
+ * Pool entries are numbered from 1, and heap allocations follow on from the end of the pool.
+ */
+class MessagePool
+{
+public:
+	static constexpr size_t capacity{SSDP_MESSAGE_POOL_SIZE};
+	static constexpr bool heapFallback{SSDP_MESSAGE_POOL_HEAP_FALLBACK};
+	static_assert(capacity < 0xffff, "SSDP_MESSAGE_POOL_SIZE too large");
+
+	/**
+	 * @brief Identifies an allocation
+	 */
+	using Index = uint16_t;
+	static constexpr Index none{0};
+
+	struct Stats {
+		uint16_t used;			  ///< Number of pool entries currently allocated
+		uint16_t peak;			  ///< High-watermark for `used`
+		uint16_t heapUsed;		  ///< Number of overflow allocations currently on the heap
+		uint32_t heapAllocations; ///< Total number of overflow allocations made from the heap
+		uint32_t failures;		  ///< Number of failed allocations
+	};
+
+	/**
+	 * @brief Allocate storage for a message
+	 * @param size Requested size, may exceed pool entry size for derived classes
+	 * @retval void* nullptr if allocation failed
+	 */
+	static void* allocate(size_t size);
+
+	static void release(void* ptr);
+
+	/**
+	 * @brief Get the index for an allocation
+	 * @param ptr Must have been returned by `allocate()`
+	 */
+	static Index indexOf(const void* ptr);
+
+	/**
+	 * @brief Get an allocation from its index
+	 * @retval void* nullptr if index is `none`
+	 */
+	static void* get(Index index);
+
+	static const Stats& getStats()
+	{
+		return stats;
+	}
+
+	/**
+	 * @brief Reset peak and cumulative counters
+	 */
+	static void resetStats()
+	{
+		stats.peak = stats.used;
+		stats.heapAllocations = 0;
+		stats.failures = 0;
+	}
+
+private:
+	static Stats stats;
+};
+
+} // namespace SSDP
@@ -20,6 +20,8 @@
 #pragma once
 
 #include "MessageSpec.h"
+#include "Stats.h"
+#include "Trace.h"
 #include <Timer.h>
 
 namespace SSDP
@@ -30,13 +32,39 @@ namespace SSDP
  */
 using MessageDelegate = Delegate<void(MessageSpec* ms)>;
 
+/*
+ * Get number of bits for a hash index with at least one bucket per message, minimum 32 buckets
+ */
+constexpr unsigned getIndexBits(unsigned messageCount, unsigned bits = 5)
+{
+	return (1U << bits) >= messageCount ? bits : getIndexBits(messageCount, bits + 1);
+}
+
 /**
  * @brief Queue of objects managed by a single timer
+ *
+ * Messages are held in a hierarchical timer wheel so that insertion and expiry
+ * cost O(1) regardless of how many messages are pending. Expired messages are
+ * moved to a ready list and dispatched one at a time, with a minimum interval between each.
+ *
+ * The minimum interval is measured from the previous dispatch, not from when a message was queued.
+ * A message added to an idle queue is therefore sent as soon as it is due, whilst one which
+ * falls due within the interval of the previous dispatch is held back until the interval has elapsed.
+ *
+ * Search responses are exempt from the minimum interval. They are already spread across the MX
+ * period of the request, and spacing them further could push them past its deadline.
+ * Unicast rate limits in the server still apply.
  */
 class MessageQueue
 {
 public:
-	MessageQueue(MessageDelegate delegate);
+	/**
+	 * @param delegate Called to send each message when due
+	 * @param instance Identifies the owning server in trace records
+	 */
+	MessageQueue(MessageDelegate delegate, uint8_t instance = 0);
+
+	MessageQueue(const MessageQueue&) = delete;
 
 	~MessageQueue()
 	{
@@ -45,7 +73,72 @@ public:
 
 	void clear();
 
-	unsigned count();
+	unsigned count() const
+	{
+		return itemCount;
+	}
+
+	uint8_t getInstance() const
+	{
+		return instance;
+	}
+
+#if SSDP_ENABLE_STATS
+	/**
+	 * @brief Get highest number of messages queued
+	 */
+	unsigned peak() const
+	{
+		return peakCount;
+	}
+
+	/**
+	 * @brief Get number of times the timer has fired
+	 */
+	uint32_t fires() const
+	{
+		return fireCount;
+	}
+
+	void resetStats()
+	{
+		peakCount = itemCount;
+		fireCount = 0;
+	}
+
+	/**
+	 * @brief Set receive time for responses added while handling a request
+	 * @param ticks Clock ticks when the request was received
+	 *
+	 * The server sets this for the duration of its receive callback, so responses an application
+	 * queues from there count towards response latency statistics.
+	 * Responses queued later should be stamped using `MessageSpec::setReceived()`.
+	 */
+	void setReceiveTime(uint32_t ticks)
+	{
+		receiveTicks = ticks;
+		stamping = true;
+	}
+
+	/**
+	 * @brief Stop stamping responses with a receive time
+	 */
+	void clearReceiveTime()
+	{
+		stamping = false;
+	}
+#endif
+
+	/**
+	 * @brief Set minimum time between dispatching messages
+	 * @param intervalMs Default is 100ms. Use 0 to dispatch expired messages as quickly as possible
+	 * and rely on the server rate limits instead.
+	 * @note Does not apply to search responses
+	 */
+	void setMinimumInterval(uint16_t intervalMs)
+	{
+		messageIntervalTicks = Timer::Millis::timeToTicks(intervalMs);
+	}
 
 	/**
 	 * @brief Set a callback to handle sending a message
@@ -63,6 +156,7 @@ public:
 	 *
 	 * The UPnP spec. requires that messages are sent after random delays, hence the interval.
 	 * MessagesSpec objects must be created using the `new` allocator and are deleted after sending.
+	 * If `ms` is nullptr (i.e. allocation failed) the call is ignored.
 	 */
 	void add(MessageSpec* ms, uint32_t intervalMs);
 
@@ -79,15 +173,129 @@ public:
 	 * @brief Remove any messages for this object
 	 * @retval unsigned Number of messages removed
 	 */
-	unsigned remove(void* object);
+	unsigned remove(void* object)
+	{
+		return remove(object, allMessageTypes);
+	}
+
+	/**
+	 * @brief Remove messages of the given types for this object
+	 * @param object
+	 * @param types Mask of message types to remove
+	 * @retval unsigned Number of messages removed
+	 */
+	unsigned remove(void* object, MessageTypeMask types);
 
 private:
+	// Unit tests step the wheel directly rather than waiting on the clock
+	friend class MessageQueueTest;
+
+	/*
+	 * Wheel geometry: each level has 32 slots, with one tick (jiffy) of level 0 being
+	 * `resolutionMs`. Three levels give a span of 32768 jiffies (about 5.5 minutes);
+	 * messages due later than that are parked in the top level and re-cascaded until due.
+	 */
+	static constexpr unsigned wheelBits{5};
+	static constexpr unsigned wheelSize{1U << wheelBits};
+	static constexpr unsigned wheelMask{wheelSize - 1};
+	static constexpr unsigned wheelLevels{3};
+	static constexpr uint32_t wheelSpan{1U << (wheelBits * wheelLevels)};
+	static constexpr uint32_t resolutionMs{10};
+	static constexpr uint8_t readySlot{0xff};
+
+	/*
+	 * Messages are also chained into two hash indices: by object, for remove(),
+	 * and by full identity, for contains().
+	 *
+	 * Both start with enough buckets for the message pool. When the number of queued messages
+	 * exceeds the number of buckets they are doubled on the heap, so chains stay short
+	 * however far the pool overflows. `clear()` returns them to the initial size.
+	 *
+	 * All lists are doubly-linked using 16-bit `MessagePool` indices, so any message
+	 * can be unlinked in constant time.
+	 */
+	using Index = MessagePool::Index;
+	using Link = Index MessageSpec::*;
+	static constexpr Index none{MessagePool::none};
+
+	static constexpr unsigned maxIndexBits{16};
+	static constexpr unsigned initialIndexBits{getIndexBits(MessagePool::capacity)};
+	static constexpr unsigned initialIndexSize{1U << initialIndexBits};
+
+	unsigned indexSize() const
+	{
+		return 1U << indexBits;
+	}
+
+	unsigned indexMask() const
+	{
+		return indexSize() - 1;
+	}
+
+	static uint32_t objectHash(void* object)
+	{
+		auto x = uint32_t(uintptr_t(object));
+		x ^= x >> 16;
+		x *= 0x45d9f3b;
+		x ^= x >> 16;
+		return x;
+	}
+
+	/*
+	 * Responses must go out within the MX period so are not held back by the minimum interval
+	 */
+	static bool isSpaced(const MessageSpec& ms)
+	{
+		return ms.type() != MessageType::response;
+	}
+
+	static MessageSpec* get(Index index)
+	{
+		return static_cast<MessageSpec*>(MessagePool::get(index));
+	}
+
+	static void push(Index& head, MessageSpec* ms, Link next, Link prev);
+	static void unchain(Index& head, MessageSpec* ms, Link next, Link prev);
+
 	void setTimer();
+	uint32_t jiffies() const;
+	void insert(MessageSpec* ms);
+	void unlink(MessageSpec* ms);
+	void unindex(MessageSpec* ms);
+	void cascade(unsigned level);
+	void expire();
+	void advance(uint32_t now);
+	uint32_t nextEvent() const;
+	void growIndex();
+	void resetIndex();
 
 	Timer timer;
 	MessageDelegate delegate;
-	MessageSpec* head{nullptr};
+	Index slots[wheelLevels][wheelSize]{};
+	uint32_t occupied[wheelLevels]{}; ///< Bitmap of non-empty slots for each level
+	Index initialIndex[2 * initialIndexSize]{};
+	Index* objectIndex{initialIndex};
+	Index* specIndex{initialIndex + initialIndexSize}; ///< Always follows `objectIndex`
+	uint8_t indexBits{uint8_t(initialIndexBits)};
+	uint8_t instance;	   ///< Owning server, for trace records
+	Index readyHead{none}; ///< Expired messages waiting to be dispatched
+	Index readyTail{none};
+	uint32_t current{0};	  ///< Next jiffy to be processed by the wheel
+	uint32_t currentTicks{0}; ///< Clock ticks corresponding to start of `current`
+	uint32_t timerJiffy{0};   ///< Jiffy for which timer is set (when waiting on the wheel)
+	uint32_t lastDispatchTicks{0};
+	uint32_t messageIntervalTicks{Timer::Millis::timeToTicks<100>()}; ///< Minimum time between dispatches
+	unsigned itemCount{0};
+#if SSDP_ENABLE_STATS
+	unsigned peakCount{0};
+	uint32_t fireCount{0};
+	uint32_t receiveTicks{0}; ///< Receive time of request being handled
+#endif
+	unsigned wheelCount{0};
 	bool timerSet{false};
+#if SSDP_ENABLE_STATS
+	bool stamping{false}; ///< Set while `receiveTicks` applies to added responses
+#endif
 };
 
 } // namespace SSDP
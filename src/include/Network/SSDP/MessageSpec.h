@@ -24,6 +24,9 @@
 #pragma once
 
 #include "Message.h"
+#include "MessagePool.h"
+#include "CompactUrn.h"
+#include "Stats.h"
 #include <IpAddress.h>
 
 #define SSDP_NOTIFY_SUBTYPE_MAP(XX)                                                                                    \
@@ -66,18 +69,69 @@ enum class SearchMatch {
 
 NotifySubtype getNotifySubtype(const char* subtype);
 
+/**
+ * @brief Compact form of the ST value of a search request
+ *
+ * Carried by responses from the built-in search responder, so that a device or service type
+ * response can echo the requested version rather than the (possibly later) version hosted.
+ * Responses to `ssdp:all` carry the URN of the entry they are for.
+ */
+struct SearchKey {
+	uint8_t kind{0}; ///< Urn::Kind
+	UrnStrings::Id domain{UrnStrings::none};
+	UrnStrings::Id type{UrnStrings::none};
+	uint8_t version{0}; ///< Minimum version requested
+
+	Urn::Kind getKind() const
+	{
+		return Urn::Kind(kind);
+	}
+
+	bool operator==(const SearchKey& other) const
+	{
+		return kind == other.kind && domain == other.domain && type == other.type && version == other.version;
+	}
+
+	/**
+	 * @brief Get the requested URN
+	 */
+	CompactUrn toUrn() const
+	{
+		CompactUrn urn;
+		urn.kind = getKind();
+		urn.domain = domain;
+		urn.type = type;
+		urn.version = version;
+		return urn;
+	}
+};
+
 /**
  * @brief Defines the information used to create an outgoing message
  *
- * The message queue stores these objects as a linked list.
+ * The message queue stores these objects as linked lists within a timer wheel.
+ * Instances created using `new` are allocated from the `MessagePool`, and `new` returns nullptr
+ * if that fails, so always check the result. `MessageQueue::add()` ignores nullptr.
+ *
+ * Copying a fan-out plan produces a regular message carrying the plan's search key.
  */
 class MessageSpec
 {
 public:
+	static void* operator new(size_t size) noexcept
+	{
+		return MessagePool::allocate(size);
+	}
+
+	static void operator delete(void* ptr)
+	{
+		MessagePool::release(ptr);
+	}
+
 	MessageSpec(MessageType type)
 	{
 		data.messageType = uint8_t(type);
-		next = nullptr;
+		next = MessagePool::none;
 	}
 
 	MessageSpec(MessageType type, SearchTarget target, void* object = nullptr)
@@ -85,7 +139,7 @@ public:
 		data.messageType = uint8_t(type);
 		data.target = uint8_t(target);
 		m_object = object;
-		next = nullptr;
+		next = MessagePool::none;
 	}
 
 	MessageSpec(NotifySubtype nts, SearchTarget target, void* object = nullptr)
@@ -94,16 +148,21 @@ public:
 		data.notifySubtype = uint8_t(nts);
 	}
 
+	MessageSpec(const MessageSpec& ms)
+	{
+		*this = ms;
+	}
+
+	MessageSpec& operator=(const MessageSpec& ms);
+
 	/**
 	 * @brief Construct a new message spec for a specific match type
 	 * @param ms Template message spec
 	 * @param match The match type
 	 * @param object Target for message
 	 */
-	MessageSpec(const MessageSpec& ms, SearchMatch match, void* object)
+	MessageSpec(const MessageSpec& ms, SearchMatch match, void* object) : MessageSpec(ms)
 	{
-		*this = ms;
-		next = nullptr;
 		data.match = uint8_t(match);
 		m_object = object;
 	}
@@ -114,6 +173,20 @@ public:
 			   (data.packed & packed_mask) == (rhs.data.packed & packed_mask);
 	}
 
+	/**
+	 * @brief Get a hash value consistent with `operator==`
+	 */
+	uint32_t hash() const
+	{
+		uint32_t x = uint32_t(uintptr_t(m_object));
+		x = (x ^ (x >> 16)) * 0x45d9f3b;
+		x ^= uint32_t(m_remoteIp);
+		x = (x ^ (x >> 16)) * 0x45d9f3b;
+		x ^= data.packed & packed_mask;
+		x = (x ^ (x >> 16)) * 0x45d9f3b;
+		return x ^ (x >> 16);
+	}
+
 	/**
 	 * @brief Get the remote IP address
 	 */
@@ -219,6 +292,178 @@ public:
 		return true;
 	}
 
+	/**
+	 * @brief Make this spec. a fan-out plan
+	 * @param intervalMs Delay between successive messages
+	 *
+	 * A plan occupies a single queue entry but produces a sequence of messages,
+	 * such as the full set of announcements for a device or responses to an `ssdp:all` search.
+	 * Each time the plan is dispatched the server calls its `FanOutDelegate` to obtain the next message.
+	 * When the sequence is complete the plan is repeated (from the start) or deleted, as for regular messages.
+	 */
+	void setFanOut(uint16_t intervalMs = 0)
+	{
+		m_flags |= flagFanOut;
+		m_interval = intervalMs;
+	}
+
+	/**
+	 * @brief Make this spec. a fan-out plan with messages spread randomly over a period
+	 * @param intervalMs Width of the slot for each message
+	 * @param periodMs Time by which all messages must be sent
+	 * @param startTicks Clock ticks at start of the period
+	 *
+	 * The period is divided into equal slots, one per message, and each message is sent
+	 * at a random point within its slot. This gives a uniform spread without bursts.
+	 * Slots are measured from `startTicks` rather than from the previous message,
+	 * so delays caused by queue resolution or throttling do not accumulate.
+	 */
+	void setRandomFanOut(uint16_t intervalMs, uint16_t periodMs, uint32_t startTicks)
+	{
+		setFanOut(intervalMs);
+		m_flags |= flagRandom;
+		m_period = periodMs;
+		m_start = startTicks;
+	}
+
+	/**
+	 * @brief Determine if fan-out plan uses random slot offsets
+	 */
+	bool isRandomFanOut() const
+	{
+		return m_flags & flagRandom;
+	}
+
+	/**
+	 * @brief Get clock ticks at start of a random fan-out period
+	 */
+	uint32_t fanOutStart() const
+	{
+		return m_start;
+	}
+
+	void setFanOutStart(uint32_t ticks)
+	{
+		m_start = ticks;
+	}
+
+	/**
+	 * @brief Get time after start by which all messages of a random fan-out are due
+	 */
+	uint16_t fanOutPeriod() const
+	{
+		return m_period;
+	}
+
+	/**
+	 * @brief Determine if this spec. is a fan-out plan
+	 */
+	bool isFanOut() const
+	{
+		return m_flags & flagFanOut;
+	}
+
+	/**
+	 * @brief Get delay between successive messages of a fan-out plan
+	 */
+	uint16_t fanOutInterval() const
+	{
+		return m_interval;
+	}
+
+	/**
+	 * @brief Get the current position within a fan-out plan
+	 *
+	 * The meaning of the cursor is defined by the `FanOutDelegate`, and is nullptr at the start of each sequence.
+	 */
+	template <class Object> Object* cursor() const
+	{
+		return static_cast<Object*>(m_cursor);
+	}
+
+	/**
+	 * @brief Set the current position within a fan-out plan
+	 */
+	void setCursor(void* cursor)
+	{
+		m_cursor = cursor;
+	}
+
+	/**
+	 * @brief Get number of messages already produced by this fan-out plan in the current sequence
+	 */
+	uint16_t step() const
+	{
+		return m_step;
+	}
+
+	/**
+	 * @brief Advance fan-out plan to next step
+	 */
+	void nextStep()
+	{
+		++m_step;
+	}
+
+	/**
+	 * @brief Get the search target this spec. is responding to
+	 *
+	 * For a message produced from a plan, this is copied from the plan's search key.
+	 */
+	const SearchKey& searchKey() const
+	{
+		return m_searchKey;
+	}
+
+	/**
+	 * @brief Set the search target this spec. is responding to
+	 */
+	void setSearchKey(const SearchKey& key)
+	{
+		m_searchKey = key;
+	}
+
+	/**
+	 * @brief Reset a fan-out plan to the start of its sequence
+	 */
+	void restart()
+	{
+		m_cursor = nullptr;
+		m_step = 0;
+	}
+
+#if SSDP_ENABLE_STATS
+	/**
+	 * @brief Record when the request which caused this response was received
+	 * @param ticks Clock ticks
+	 *
+	 * Responses queued from within the server's receive callback are stamped automatically.
+	 * Call this for responses queued later so they are included in latency statistics.
+	 */
+	void setReceived(uint32_t ticks)
+	{
+		m_received = ticks;
+		m_flags |= flagReceived;
+	}
+
+	/**
+	 * @brief Determine if receive time of the request which caused this response is known
+	 */
+	bool hasReceived() const
+	{
+		return m_flags & flagReceived;
+	}
+
+	/**
+	 * @brief Get when the request which caused this response was received
+	 * @retval uint32_t Clock ticks, only meaningful if `hasReceived()` returns true
+	 */
+	uint32_t received() const
+	{
+		return m_received;
+	}
+#endif
+
 private:
 	void* m_object{nullptr}; ///< Defined by UPnP or application
 	IpAddress m_remoteIp{};  ///< Where to send message
@@ -234,13 +479,36 @@ private:
 		uint32_t packed{0};
 	};
 	Data data;
+	SearchKey m_searchKey; ///< Search responses: the requested target
+#if SSDP_ENABLE_STATS
+	uint32_t m_received{0}; ///< Clock ticks when search request was received
+#endif
+	// Fan-out plan state, kept here so a plan needs only one pool entry
+	void* m_cursor{nullptr}; ///< Position, managed by FanOutDelegate
+	uint32_t m_start{0};	 ///< Clock ticks from which random slots are measured
+	uint16_t m_step{0};		 ///< Messages produced in current sequence
+	uint16_t m_interval{0};	 ///< Delay between messages
+	uint16_t m_period{0};	 ///< Time after start by which all random messages are due
+	uint8_t m_flags{0};		 ///< Combination of `flagXXX` values
 	// Compare all but the repeat value
 	static constexpr uint32_t packed_mask{0x03FFFFFF};
+	static constexpr uint8_t flagFanOut{0x01};	 ///< Spec. is a fan-out plan
+	static constexpr uint8_t flagRandom{0x02};	 ///< Randomise position within each interval
+	static constexpr uint8_t flagReceived{0x04}; ///< `m_received` has been set
 
-	// These fields are used by the message queue
+	/*
+	 * These fields are used by the message queue, links are `MessagePool` indices.
+	 * Ordered so that the whole object packs into 48 bytes (52 with stats) on 32-bit targets.
+	 */
 	friend class MessageQueue;
-	uint32_t due;	  ///< Absolute clock tick value when this message should be sent
-	MessageSpec* next; ///< Next message in the list
+	uint8_t slot;				   ///< Wheel slot (level and index) or ready list
+	uint32_t due;				   ///< Wheel time (in jiffies) when this message should be sent
+	MessagePool::Index next;	   ///< Next message in the slot or ready list
+	MessagePool::Index prev;	   ///< Previous message in the slot or ready list
+	MessagePool::Index objectNext; ///< Next message in object index chain
+	MessagePool::Index objectPrev; ///< Previous message in object index chain
+	MessagePool::Index specNext;   ///< Next message in identity index chain
+	MessagePool::Index specPrev;   ///< Previous message in identity index chain
 };
 
 } // namespace SSDP
@@ -0,0 +1,109 @@
+/****
+ * RateLimit.h - Token bucket pacing for outgoing messages
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include <Timer.h>
+#include <Platform/RTC.h>
+
+namespace SSDP
+{
+/**
+ * @brief A token bucket refilled at a constant rate
+ *
+ * The bucket holds at most one second's worth of tokens, so short bursts are allowed
+ * but the sustained rate is capped. Tokens are held in thousandths to avoid rounding loss.
+ * A bucket may be overdrawn, in which case the debt must be repaid before further sending.
+ *
+ * Elapsed time is measured using clock ticks, which wrap. The RTC seconds count is also
+ * recorded so that idle periods longer than the tick clock's range are fully credited.
+ */
+class TokenBucket
+{
+public:
+	/**
+	 * @brief Set refill rate
+	 * @param perSecond 0 for no limit
+	 */
+	void setRate(uint16_t perSecond)
+	{
+		rate = perSecond;
+		level = int32_t(rate) * 1000;
+		lastTicks = Timer::Clock::ticks();
+		lastSeconds = RTC.getRtcSeconds();
+	}
+
+	uint16_t getRate() const
+	{
+		return rate;
+	}
+
+	/**
+	 * @brief Get time until the given number of tokens is available
+	 * @retval uint32_t Milliseconds, 0 if tokens are available now
+	 */
+	uint32_t wait(uint16_t tokens);
+
+	/**
+	 * @brief Take tokens from the bucket, which may leave it overdrawn
+	 */
+	void consume(uint16_t tokens)
+	{
+		if(rate != 0) {
+			refill();
+			level -= int32_t(tokens) * 1000;
+		}
+	}
+
+private:
+	void refill();
+
+	int32_t level{0}; ///< Available tokens x 1000
+	uint32_t lastTicks{0};
+	uint32_t lastSeconds{0}; ///< RTC time corresponding to `lastTicks`, to detect clock wrap
+	uint16_t rate{0};
+};
+
+/**
+ * @brief Packet and byte rate limits for one class of traffic
+ */
+struct RateLimit {
+	TokenBucket packets;
+	TokenBucket bytes;
+
+	/**
+	 * @brief Get time until another message may be sent
+	 * @retval uint32_t Milliseconds, 0 if message may be sent now
+	 */
+	uint32_t wait()
+	{
+		// Size of next message isn't known in advance, so just require any byte debt to be paid off
+		auto t1 = packets.wait(1);
+		auto t2 = bytes.wait(0);
+		return (t1 > t2) ? t1 : t2;
+	}
+
+	void consume(size_t length)
+	{
+		packets.consume(1);
+		bytes.consume(length);
+	}
+};
+
+} // namespace SSDP
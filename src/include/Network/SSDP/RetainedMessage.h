@@ -0,0 +1,144 @@
+/****
+ * RetainedMessage.h - Compact copy of a received message
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include "Message.h"
+
+namespace SSDP
+{
+/**
+ * @brief Read-only copy of a received message which may be kept after the receive callback returns
+ *
+ * All header names and values are stored in a single heap allocation together with
+ * an offset index, including the well-known header slots. The read API matches `BasicMessage`.
+ * Use `Message` instead if headers need to be modified.
+ */
+class RetainedMessage
+{
+public:
+	using Header = BasicHttpHeaders::Header;
+
+	/**
+	 * @brief Maximum number of headers which can be retained
+	 */
+	static constexpr unsigned maxHeaders{254};
+
+	RetainedMessage()
+	{
+	}
+
+	RetainedMessage(const BasicMessage& msg)
+	{
+		assign(msg);
+	}
+
+	RetainedMessage(const RetainedMessage& other)
+	{
+		*this = other;
+	}
+
+	RetainedMessage(RetainedMessage&& other)
+		: type(other.type), remoteIP(other.remoteIP), remotePort(other.remotePort), block(other.block)
+	{
+		other.block = nullptr;
+	}
+
+	~RetainedMessage()
+	{
+		clear();
+	}
+
+	RetainedMessage& operator=(const RetainedMessage& other);
+
+	RetainedMessage& operator=(RetainedMessage&& other);
+
+	/**
+	 * @brief Take a copy of a received message
+	 * @retval bool false on memory allocation failure, or if the message has more than `maxHeaders`
+	 * headers or exceeds 64KB. The message is left empty.
+	 */
+	bool assign(const BasicMessage& msg);
+
+	void clear();
+
+	/**
+	 * @brief Determine if message is valid
+	 */
+	explicit operator bool() const
+	{
+		return block != nullptr;
+	}
+
+	unsigned count() const
+	{
+		return block ? block->count : 0;
+	}
+
+	Header operator[](unsigned i) const;
+
+	/**
+	 * @brief Find a header by name, case is ignored
+	 */
+	const char* operator[](const char* name) const;
+
+	const char* operator[](HeaderId id) const;
+
+	/**
+	 * @see `BasicMessage::getMaxWait()`
+	 */
+	uint8_t getMaxWait() const
+	{
+		return SSDP::getMaxWait(operator[](HeaderId::mx));
+	}
+
+	MessageType type{MessageType::notify};
+	IpAddress remoteIP;
+	uint16_t remotePort{0};
+
+private:
+	static constexpr uint8_t noHeader{0xff};
+
+	/*
+	 * Allocation layout:
+	 *
+	 *	Block
+	 *	uint16_t offsets[count * 2]		Name and value offsets within text
+	 *	char text[size]					NUL-terminated names and values
+	 */
+	struct Block {
+		uint16_t size;	///< Total allocation size
+		uint8_t count; ///< Number of headers
+		uint8_t slots[unsigned(HeaderId::MAX)]; ///< Header index for well-known headers
+	};
+
+	const uint16_t* offsets() const
+	{
+		return reinterpret_cast<const uint16_t*>(block + 1);
+	}
+
+	const char* text() const
+	{
+		return reinterpret_cast<const char*>(offsets() + block->count * 2);
+	}
+
+	Block* block{nullptr};
+};
+
+} // namespace SSDP
@@ -0,0 +1,95 @@
+/****
+ * SearchHistory.h - Track recent M-SEARCH requests
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include "Message.h"
+
+namespace SSDP
+{
+/**
+ * @brief Fixed-size hash table of recently received M-SEARCH requests
+ *
+ * Control points commonly send the same request several times in quick succession.
+ * Each request is identified by remote address, port, ST and MX values; repeats
+ * received within the expiry window are reported as duplicates.
+ */
+class SearchHistory
+{
+public:
+	static constexpr unsigned capacity{8};
+	/**
+	 * @brief Default duplicate window
+	 *
+	 * Disabled, so every request reaches the application as it always has.
+	 */
+	static constexpr uint16_t defaultWindowMs{0};
+
+	/**
+	 * @brief Suggested duplicate window
+	 *
+	 * Responses to the first request are spread across at least this period (the shortest MX),
+	 * so repeats within it need not be answered again.
+	 */
+	static constexpr uint16_t recommendedWindowMs{minMaxWait * 1000U};
+
+	/**
+	 * @brief Record a search request
+	 * @param msg The received M-SEARCH
+	 * @retval bool true if request is a duplicate of one received within the window
+	 * @note Duplicates do not refresh the recorded time, so the window runs from the first request.
+	 * Nothing is recorded if duplicate detection is disabled.
+	 */
+	bool check(const BasicMessage& msg);
+
+	/**
+	 * @brief Set period over which repeated requests are considered duplicates
+	 * @param windowMs 0 to disable
+	 */
+	void setWindow(uint16_t windowMs)
+	{
+		this->windowMs = windowMs;
+	}
+
+	/**
+	 * @brief Get number of duplicate requests detected
+	 */
+	uint32_t suppressed() const
+	{
+		return suppressCount;
+	}
+
+	void clear();
+
+private:
+	struct Entry {
+		uint32_t ip;
+		uint32_t stHash;
+		uint32_t timestamp; ///< Clock ticks when first received
+		uint16_t port;
+		uint8_t mx;
+		bool used;
+	};
+
+	Entry entries[capacity]{};
+	uint32_t suppressCount{0};
+	uint16_t windowMs{defaultWindowMs};
+};
+
+} // namespace SSDP
@@ -0,0 +1,143 @@
+/****
+ * SearchIndex.h - Match search targets to hosted objects
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include "MessageSpec.h"
+#include "CompactUrn.h"
+
+#ifndef SSDP_SEARCH_INDEX_SIZE
+#define SSDP_SEARCH_INDEX_SIZE 16
+#endif
+
+namespace SSDP
+{
+/**
+ * @brief Index of hosted URNs used to answer M-SEARCH requests
+ *
+ * Each entry associates a root, uuid, device type or service type URN with an object.
+ * Entries are chained into hash buckets by kind, domain and type so a search only
+ * examines entries which could match. Device and service types match if the registered
+ * version is the same or later than the one requested.
+ *
+ * A search produces a fan-out plan whose object is the index itself. The plan carries the requested
+ * target as a `SearchKey` and its cursor records the position within the bucket chain, so matching responses
+ * are produced one at a time via `next()`. Plans remain valid if entries are removed whilst in progress.
+ * Responses to `ssdp:all` come in bucket order.
+ */
+class SearchIndex
+{
+public:
+	static constexpr size_t capacity{SSDP_SEARCH_INDEX_SIZE};
+	static_assert(capacity < 255, "SSDP_SEARCH_INDEX_SIZE too large");
+
+	SearchIndex();
+
+	/**
+	 * @brief Register a URN for an object
+	 * @retval bool false if index is full, URN is invalid or its strings could not be interned
+	 * @note Any UUID in the URN is not used, so need not be in standard form
+	 */
+	bool add(const Urn& urn, void* object);
+
+	/**
+	 * @brief Remove all entries for an object
+	 */
+	void remove(void* object);
+
+	void clear();
+
+	size_t count() const
+	{
+		return itemCount;
+	}
+
+	/**
+	 * @brief Find objects matching a search target
+	 * @param st Value of ST header
+	 * @param plan Response template. On success the target, search key and cursor are set
+	 * ready for calls to `next()`.
+	 * @retval unsigned Number of matches
+	 * @note `uuid:` targets are not handled here, see `DeviceRegistry`
+	 */
+	unsigned find(const char* st, MessageSpec& plan) const;
+
+	/**
+	 * @brief Get the next response for a search
+	 * @param plan As set up by `find()`
+	 * @param ms On success, the response to send
+	 * @retval bool false if there are no more matches
+	 */
+	bool next(MessageSpec& plan, MessageSpec& ms) const;
+
+	/**
+	 * @brief Determine if a search has more responses to produce
+	 * @param plan As set up by `find()`
+	 * @retval bool true if `next()` would succeed
+	 */
+	bool hasNext(const MessageSpec& plan) const
+	{
+		unsigned bucket;
+		unsigned pos;
+		return scan(plan, bucket, pos);
+	}
+
+private:
+	static constexpr uint8_t none{0xff};
+	static constexpr unsigned bucketCount{16};
+
+	struct Entry {
+		void* object{nullptr}; ///< nullptr if entry is free
+		Urn::Kind kind{};
+		UrnStrings::Id domain{UrnStrings::none};
+		UrnStrings::Id type{UrnStrings::none};
+		uint8_t version{0};
+		uint8_t next{none}; ///< Next entry in bucket chain
+
+		bool sameKey(const Entry& other) const
+		{
+			return kind == other.kind && domain == other.domain && type == other.type;
+		}
+
+		/**
+		 * @brief Determine if this entry satisfies a search
+		 * @param key Requested kind, domain and type with minimum version
+		 */
+		bool matches(const Entry& key) const
+		{
+			return object != nullptr && sameKey(key) && version >= key.version;
+		}
+	};
+
+	/*
+	 * Locate the next entry to respond with
+	 */
+	bool scan(const MessageSpec& plan, unsigned& bucket, unsigned& pos) const;
+
+	static unsigned getBucket(const Entry& e)
+	{
+		return ((unsigned(e.kind) * 31 + e.domain) * 31 + e.type) % bucketCount;
+	}
+
+	Entry entries[capacity];
+	uint8_t buckets[bucketCount];
+	size_t itemCount{0};
+};
+
+} // namespace SSDP
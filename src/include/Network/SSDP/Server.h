@@ -21,7 +21,15 @@
 
 #include <Network/UdpConnection.h>
 #include "MessageQueue.h"
+#include "TemplateCache.h"
+#include "SearchHistory.h"
+#include "Stats.h"
+#include "DeviceRegistry.h"
+#include "SearchIndex.h"
+#include "RateLimit.h"
+#include "Trace.h"
 #include <Data/CString.h>
+#include <algorithm>
 
 #define UPNP_VERSION_IS(ver) (F(MACROQUOTE(ver)) == MACROQUOTE(UPNP_VERSION))
 
@@ -43,31 +51,59 @@ using ReceiveDelegate = Delegate<void(BasicMessage& message)>;
  * @param ms Parameters for constructing message
  * @note The message spec. is provided by the UPnP Device Host, which then gets called
  * back to construct the message content. It then calls `sendMessage()`.
+ *
+ * For responses to device or service type searches, `ST` must echo the requested target
+ * (see `MessageSpec::searchKey()`) rather than the version hosted. The server takes care of this
+ * when the message is sent, replacing any `ST` value set here.
  */
 using SendDelegate = Delegate<void(Message& msg, MessageSpec& ms)>;
 
+/**
+ * @brief Callback type for obtaining the next message from a fan-out plan
+ * @param plan The plan being dispatched. Use `cursor()` and `step()` to track progress.
+ * @param ms On success, set to the message to be sent, e.g. `ms = MessageSpec(plan, SearchMatch::type, service)`
+ * @retval bool false when there are no more messages in the sequence
+ */
+using FanOutDelegate = Delegate<bool(MessageSpec& plan, MessageSpec& ms)>;
+
+/**
+ * @brief Callback type to intercept outgoing datagrams
+ * @param remoteIP Destination address
+ * @param remotePort Destination port
+ * @param data Formatted message content, valid only for the duration of the call
+ * @param length Number of characters in `data`
+ * @retval bool true if message was handled successfully
+ */
+using SendSink = Delegate<bool(IpAddress remoteIP, uint16_t remotePort, const char* data, size_t length)>;
+
 /**
  * @brief Listens for incoming messages and manages queue of outgoing messages
- * @note The spec. talks about random intervals, etc. but to keep things simple we just
- * use a timer to spread all these messages out at regular intervals.
- * @todo Randomise the time as required by MX and keep queue ordered by time.
- * Each message is 12 bytes, adding time would make this 16.
- * Need to handle alives < 1/2 expiry time as well so timer will always be active.
- * Could also use a linked list so an additional pointer would make it 20 bytes.
  *
- * Note: This is basically another timer queue, so we could use software timers
- * directly but potentially there could be a lot of them. Better I think to use a single
- * `Timer` and drive it from that.
+ * Outgoing messages are scheduled using a single `MessageQueue`, which holds them in a timer wheel
+ * ordered by due time. Search responses are spread randomly across the MX period of the request.
+ *
+ * Each instance has its own queue, caches, registries and sockets. The `MessagePool`, `UrnStrings`
+ * table and `Trace` buffer are shared by all instances.
  */
 class Server : private UdpConnection
 {
 public:
 	static constexpr uint8_t multicastTtl{2};
 
-	Server() : messageQueue(MessageDelegate(&Server::onMessage, this))
+	Server() : messageQueue(MessageDelegate(&Server::onMessage, this), nextInstance()), out(*this)
 	{
 	}
 
+	/**
+	 * @brief Get number identifying this server in trace records
+	 *
+	 * Instances are numbered from 0 in order of construction.
+	 */
+	uint8_t getInstance() const
+	{
+		return messageQueue.getInstance();
+	}
+
 	/**
 	 * @brief Called from UPnP library to start SSDP server
 	 * @note May only be called once
@@ -75,6 +111,18 @@ public:
 	 */
 	bool begin(ReceiveDelegate receiveCallback, SendDelegate sendCallback);
 
+	/**
+	 * @brief Set callbacks without starting the network service
+	 *
+	 * `begin()` sets these itself. Use this instead to process messages via `receive()` and
+	 * `setSendSink()` without binding any sockets, e.g. when replaying captured traffic.
+	 */
+	void setDelegates(ReceiveDelegate receiveCallback, SendDelegate sendCallback)
+	{
+		receiveDelegate = receiveCallback;
+		sendDelegate = sendCallback;
+	}
+
 	/**
 	 * @brief Stop SSDP server
 	 */
@@ -94,6 +142,28 @@ public:
 	 */
 	bool sendMessage(const Message& msg);
 
+	/**
+	 * @brief Process a message as if it had been received from the network
+	 * @param data Message text, will be modified during parsing
+	 * @param len Length of text
+	 * @param remoteIP Sender address
+	 * @param remotePort Sender port
+	 *
+	 * Used for replaying captured traffic, e.g. when testing on a Host build.
+	 * Unlike network traffic the sender address is not checked.
+	 * The server need not have been started: see `setDelegates()`.
+	 */
+	void receive(char* data, size_t len, IpAddress remoteIP, uint16_t remotePort);
+
+	/**
+	 * @brief Redirect outgoing messages
+	 * @param sink Callback to receive datagrams instead of sending them, nullptr to restore normal operation
+	 */
+	void setSendSink(SendSink sink)
+	{
+		sendSink = sink;
+	}
+
 	/**
 	 * @brief Construct a message from the given template spec.
 	 * @param msg Fields of this message will be filled out
@@ -102,6 +172,155 @@ public:
 	 */
 	bool buildMessage(Message& msg, MessageSpec& ms);
 
+	/**
+	 * @brief Set MX value for outgoing M-SEARCH requests
+	 * @param seconds Maximum time devices should wait before responding, constrained to 1 - 5
+	 */
+	void setSearchMaxWait(uint8_t seconds)
+	{
+		searchMaxWait = std::max(minMaxWait, std::min(seconds, maxMaxWait));
+	}
+
+	/**
+	 * @brief Set callback used to enumerate messages for fan-out plans
+	 * @see `MessageSpec::setFanOut()`
+	 */
+	void setFanOutCallback(FanOutDelegate delegate)
+	{
+		fanOutDelegate = delegate;
+	}
+
+	/**
+	 * @brief Restrict which incoming messages are parsed and passed to the application
+	 * @param types Mask of message types to accept, e.g. `getMask(MessageType::msearch)`
+	 * @param targetPrefix If set, only accept messages whose NT (NOTIFY) or ST (M-SEARCH, response) value
+	 * starts with this string
+	 *
+	 * M-SEARCH requests for `ssdp:all`, `upnp:rootdevice` or `uuid:...` are always accepted
+	 * since they may apply to any device.
+	 *
+	 * Checks are made by scanning only the start line and relevant header of the raw message,
+	 * so rejected datagrams incur very little processing.
+	 */
+	void setAcceptFilter(MessageTypeMask types, const String& targetPrefix = nullptr)
+	{
+		acceptTypes = types;
+		acceptPrefix = targetPrefix;
+	}
+
+	/**
+	 * @brief Set period within which repeated M-SEARCH requests are ignored
+	 * @param windowMs 0 to pass all requests to the application
+	 *
+	 * Requests are considered duplicates if they have the same remote address, port, ST and MX values.
+	 * The window is measured from the first request, so repeats do not extend it.
+	 * Disabled by default. `SearchHistory::recommendedWindowMs` (one second) suits most applications.
+	 */
+	void setSearchWindow(uint16_t windowMs)
+	{
+		searchHistory.setWindow(windowMs);
+	}
+
+	/**
+	 * @brief Get number of duplicate M-SEARCH requests which have been ignored
+	 */
+	uint32_t suppressedSearches() const
+	{
+		return searchHistory.suppressed();
+	}
+
+	/**
+	 * @brief Limit rate of queued multicast messages (NOTIFY and M-SEARCH)
+	 * @param packetsPerSecond 0 for no limit
+	 * @param bytesPerSecond 0 for no limit
+	 *
+	 * Up to one second's allowance may be sent in a burst. Messages exceeding the limit
+	 * are deferred, not dropped. See also `MessageQueue::setMinimumInterval()`.
+	 */
+	void setMulticastLimit(uint16_t packetsPerSecond, uint16_t bytesPerSecond)
+	{
+		multicastLimit.packets.setRate(packetsPerSecond);
+		multicastLimit.bytes.setRate(bytesPerSecond);
+	}
+
+	/**
+	 * @brief Limit rate of queued unicast messages (search responses)
+	 * @see `setMulticastLimit()`
+	 */
+	void setUnicastLimit(uint16_t packetsPerSecond, uint16_t bytesPerSecond)
+	{
+		unicastLimit.packets.setRate(packetsPerSecond);
+		unicastLimit.bytes.setRate(bytesPerSecond);
+	}
+
+	/**
+	 * @brief Register a hosted device
+	 * @param uuid The device UUID
+	 * @param object Passed to the `SendDelegate` via `MessageSpec::object()`
+	 * @retval bool false if registry is full and could not be enlarged
+	 *
+	 * M-SEARCH requests for `uuid:{device-UUID}` targets are answered directly for registered devices:
+	 * a response with `SearchMatch::uuid` is queued and the `ReceiveDelegate` is not called.
+	 */
+	bool addDevice(const Uuid& uuid, void* object)
+	{
+		return devices.add(uuid, object);
+	}
+
+	/**
+	 * @brief Remove a hosted device
+	 * @param object As passed to `addDevice()`
+	 * @note Cached message templates for the object are discarded
+	 */
+	void removeDevice(void* object)
+	{
+		devices.remove(object);
+		templates.invalidate(object);
+	}
+
+	/**
+	 * @brief Register a URN hosted by an object
+	 * @param urn A root, uuid, device or service URN
+	 * @param object Passed to the `SendDelegate` via `MessageSpec::object()`
+	 * @retval bool false if there is no room or the URN cannot be indexed. A `uuid:{device-UUID}` URN
+	 * must have a UUID in standard form. Nothing is registered on failure.
+	 *
+	 * Matching M-SEARCH requests are answered directly, with the appropriate `SearchMatch`,
+	 * and the `ReceiveDelegate` is not called. Device and service types match requests for the same
+	 * or earlier version. Where there are several matches, such as for `ssdp:all`, a single fan-out plan
+	 * spreads the responses across the MX period.
+	 */
+	bool addSearchTarget(const Urn& urn, void* object);
+
+	/**
+	 * @brief Remove all URNs registered for an object
+	 * @note Queued search responses for the object are cancelled, and its cached message templates
+	 * discarded. Responses to other objects from searches in progress are unaffected.
+	 */
+	void removeSearchTargets(void* object);
+
+#if SSDP_ENABLE_STATS
+	/**
+	 * @brief Get server statistics
+	 */
+	const Stats& getStats()
+	{
+		stats.queueDepth = messageQueue.count();
+		stats.queuePeak = messageQueue.peak();
+		stats.timerFires = messageQueue.fires();
+		return stats;
+	}
+
+	/**
+	 * @brief Zero all counters
+	 */
+	void resetStats()
+	{
+		stats = Stats{};
+		messageQueue.resetStats();
+	}
+#endif
+
 	/**
 	 * @brief Set product name and version contained in SSDP message USER-AGENT field
 	 */
@@ -112,6 +331,22 @@ public:
 		s += '/';
 		s += version;
 		productNameAndVersion = s;
+		templates.invalidate();
+	}
+
+	/**
+	 * @brief Discard cached message templates
+	 * @param object Only discard templates for this object, nullptr for all
+	 *
+	 * When `SSDP_TEMPLATE_CACHE_SIZE` is non-zero, NOTIFY and search response messages
+	 * built by the `SendDelegate` are cached and re-sent directly, with DATE, HOST and ST regenerated.
+	 * The delegate is not called for these messages. Applications must call this method whenever
+	 * the content of such messages would change, or before an object is destroyed.
+	 * `removeDevice()` and `removeSearchTargets()` do this for the object concerned.
+	 */
+	void invalidateTemplates(void* object = nullptr)
+	{
+		templates.invalidate(object);
 	}
 
 public:
@@ -121,25 +356,109 @@ protected:
 	void onReceive(pbuf* buf, IpAddress remoteIP, uint16_t remotePort) override;
 
 private:
+	// Unit tests inspect internal state directly
+	friend class TemplateCacheTest;
+	friend class ServerTest;
+
 	/*
 	 * Need a separate UDP connection for sending requests
 	 */
 	class UdpOut : public UdpConnection
 	{
+	public:
+		UdpOut(Server& owner) : owner(owner)
+		{
+		}
+
+		/**
+		 * @brief Bind to a local port, if not already done
+		 */
+		bool bind();
+
+		void end();
+
+		/**
+		 * @brief Send a datagram without copying it
+		 */
+		bool send(pbuf* buf, IpAddress remoteIP, uint16_t remotePort);
+
 	protected:
 		void onReceive(pbuf* buf, IpAddress remoteIP, uint16_t remotePort) override;
+
+	private:
+		Server& owner;
+		bool bound{false};
 	};
 
+	static uint8_t nextInstance();
+	bool accept(const char* data, size_t len);
+	bool search(const BasicMessage& msg);
+	void handleChain(pbuf* buf, size_t len, IpAddress remoteIP, uint16_t remotePort);
+	void handleMessage(char* data, size_t len, IpAddress remoteIP, uint16_t remotePort);
+	bool sendData(MessageType type, IpAddress remoteIP, uint16_t remotePort, pbuf* buf);
+	bool sendTemplate(const MessageSpec& ms);
+	bool updateDate();
 	void onTimer();
 	void onMessage(MessageSpec* ms);
+	void onFanOut(MessageSpec* plan);
+	void queueRandomFanOut(MessageSpec* plan);
+	void dispatch(MessageSpec& ms);
+	bool throttle(MessageSpec* ms);
+
+	/*
+	 * Address a message built from a spec will be sent to
+	 */
+	static IpAddress getDestination(const MessageSpec& ms)
+	{
+		// M-SEARCH requests are always multicast
+		return (ms.type() == MessageType::msearch) ? multicastIp : ms.remoteIp();
+	}
+
+	/*
+	 * Queued messages are throttled, and sent messages charged, according to where they go
+	 */
+	RateLimit& getRateLimit(IpAddress remoteIP)
+	{
+		return (remoteIP == multicastIp) ? multicastLimit : unicastLimit;
+	}
+
+	void drop(DropReason reason, IpAddress remoteIP)
+	{
+		SSDP_STAT(stats.drop(reason));
+		SSDP_TRACE(getInstance(), drop, uint8_t(reason), 0, uint32_t(remoteIP));
+	}
 
 	ReceiveDelegate receiveDelegate{nullptr};
 	SendDelegate sendDelegate{nullptr};
+	FanOutDelegate fanOutDelegate{nullptr};
+	SendSink sendSink{nullptr};
 	UdpOut out;
 	bool active{false};
 	CString productNameAndVersion;
+	CString acceptPrefix;
+	MessageTypeMask acceptTypes{allMessageTypes};
+	TemplateCache templates;
+	SearchHistory searchHistory;
+	DeviceRegistry devices;
+	SearchIndex searchIndex;
+	RateLimit multicastLimit;
+	RateLimit unicastLimit;
+#if SSDP_ENABLE_STATS
+	Stats stats{};
+#endif
+	uint8_t searchMaxWait{3};				 ///< MX value for outgoing searches
+	const MessageSpec* dispatching{nullptr}; ///< Message being sent, for ST echo and response latency
+	MessageSpec* capture{nullptr};			 ///< Set whilst building a message which may be cached
+	time_t dateTime{0};						 ///< Time corresponding to `date`
+	String date;							 ///< Cached DATE field value
 };
 
+/**
+ * @brief Default server instance
+ *
+ * Applications may create additional instances, each with its own queue, caches and sockets.
+ * See `Server` for state shared between instances.
+ */
 extern Server server;
 
 } // namespace SSDP
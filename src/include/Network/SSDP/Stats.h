@@ -0,0 +1,114 @@
+/****
+ * Stats.h - SSDP server statistics
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include "Message.h"
+
+#ifndef SSDP_ENABLE_STATS
+#define SSDP_ENABLE_STATS 0
+#endif
+
+/*
+ * Used internally to update statistics, compiles to nothing if disabled
+ */
+#if SSDP_ENABLE_STATS
+#define SSDP_STAT(stmt) stmt
+#else
+#define SSDP_STAT(stmt)
+#endif
+
+#define SSDP_DROP_REASON_MAP(XX)                                                                                       \
+	XX(nonLocal, "Remote address not on local network")                                                               \
+	XX(empty, "Empty datagram")                                                                                        \
+	XX(tooLarge, "Text exceeds SSDP_MAX_RECEIVE_SIZE")                                                                 \
+	XX(noMemory, "No buffer to gather fragmented text")                                                                \
+	XX(filtered, "Rejected by accept filter")                                                                          \
+	XX(duplicate, "Repeated M-SEARCH")
+
+namespace SSDP
+{
+/**
+ * @brief Reasons for discarding a received datagram
+ */
+enum class DropReason {
+#define XX(tag, comment) tag,
+	SSDP_DROP_REASON_MAP(XX)
+#undef XX
+		MAX
+};
+
+#if SSDP_ENABLE_STATS
+
+/**
+ * @brief Counters maintained by the server when `SSDP_ENABLE_STATS` is set
+ */
+struct Stats {
+	static constexpr unsigned messageTypeCount{
+#define XX(tag) 1 +
+		SSDP_MESSAGE_TYPE_MAP(XX)
+#undef XX
+			0};
+	static constexpr unsigned parseErrorCount{HPE_UNKNOWN + 1};
+	static constexpr unsigned dropReasonCount{unsigned(DropReason::MAX)};
+	static constexpr unsigned latencyBucketCount{8};
+
+	/**
+	 * @brief Upper bound (exclusive) for each latency bucket except the last, in milliseconds
+	 */
+	static constexpr uint16_t latencyLimits[latencyBucketCount - 1]{100, 250, 500, 1000, 2000, 3000, 5000};
+
+	uint32_t rx[messageTypeCount];				  ///< Messages received, by type
+	uint32_t tx[messageTypeCount];				  ///< Messages sent, by type
+	uint32_t parseErrors[parseErrorCount];		  ///< Parse failures by HttpError, HPE_UNKNOWN includes higher values
+	uint32_t drops[dropReasonCount];			  ///< Discarded datagrams, by reason
+	uint32_t sendFailures;						  ///< Failed UDP sends
+	uint32_t timerFires;						  ///< Number of times message queue timer has fired
+	uint32_t throttled;							  ///< Messages deferred by rate limits
+	uint16_t queueDepth;						  ///< Messages currently queued
+	uint16_t queuePeak;							  ///< Peak number of messages queued
+	uint32_t responseLatency[latencyBucketCount]; ///< Time from M-SEARCH receipt to response sent
+
+	void parseError(HttpError err)
+	{
+		++parseErrors[(unsigned(err) < parseErrorCount) ? unsigned(err) : unsigned(HPE_UNKNOWN)];
+	}
+
+	void drop(DropReason reason)
+	{
+		++drops[unsigned(reason)];
+	}
+
+	void latency(uint32_t ms)
+	{
+		unsigned i = 0;
+		while(i < latencyBucketCount - 1 && ms >= latencyLimits[i]) {
+			++i;
+		}
+		++responseLatency[i];
+	}
+};
+
+#endif
+
+} // namespace SSDP
+
+#if SSDP_ENABLE_STATS
+String toString(SSDP::DropReason reason);
+#endif
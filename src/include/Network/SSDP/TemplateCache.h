@@ -0,0 +1,147 @@
+/****
+ * TemplateCache.h - Cache of pre-rendered outgoing messages
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include "MessageSpec.h"
+
+#ifndef SSDP_TEMPLATE_CACHE_SIZE
+#define SSDP_TEMPLATE_CACHE_SIZE 0
+#endif
+
+namespace SSDP
+{
+/**
+ * @brief Holds rendered NOTIFY and search response messages
+ *
+ * A template is keyed on the object and on everything in the spec. from which the application
+ * constructs a message: type, notification subtype, match, target and the full search key.
+ * So text rendered by the `SendDelegate` is only ever re-used for the same kind of message,
+ * e.g. a response to a search for one device type is never sent in reply to a search for another.
+ *
+ * Fields which may differ between sends are located when a template is stored, and regenerated each
+ * time it is used: DATE from the clock, HOST from the destination and, for type search responses,
+ * ST from the search key. The text between them, including NT and USN which depend only on the key,
+ * is sent as rendered.
+ *
+ * Entries are recycled on a least-recently-used basis.
+ */
+class TemplateCache
+{
+public:
+	static constexpr size_t capacity{SSDP_TEMPLATE_CACHE_SIZE};
+
+	/**
+	 * @brief Identifies fields regenerated for each send
+	 */
+	enum class FieldId : uint8_t {
+		date,
+		host,
+		st,
+		MAX,
+	};
+
+	/**
+	 * @brief Position of a field value within template text
+	 */
+	struct Field {
+		uint16_t offset;
+		uint16_t length;
+		FieldId id;
+	};
+
+	static constexpr size_t maxFields{size_t(FieldId::MAX)};
+
+	struct Key {
+		uint32_t spec{0}; ///< Message type, notification subtype, match and target
+		SearchKey search;
+
+		bool operator==(const Key& other) const
+		{
+			return spec == other.spec && search == other.search;
+		}
+	};
+
+	struct Entry {
+		void* object{nullptr};
+		Key key;
+		uint32_t lastUsed{0};
+		Field fields[maxFields]; ///< Variable fields, in the order they appear
+		uint8_t fieldCount{0};
+		String data;
+
+		/**
+		 * @brief Get a variable field
+		 * @retval const Field* nullptr if the template does not contain the field
+		 */
+		const Field* getField(FieldId id) const
+		{
+			for(unsigned i = 0; i < fieldCount; ++i) {
+				if(fields[i].id == id) {
+					return &fields[i];
+				}
+			}
+			return nullptr;
+		}
+	};
+
+	/**
+	 * @brief Determine if a message spec. is suitable for caching
+	 */
+	static bool isCacheable(const MessageSpec& ms)
+	{
+		return ms.type() != MessageType::msearch;
+	}
+
+	/**
+	 * @brief Find a template for the given message spec.
+	 * @retval Entry* nullptr if not found
+	 */
+	const Entry* find(const MessageSpec& ms);
+
+	/**
+	 * @brief Store rendered message
+	 * @param ms Spec. the message was built from
+	 * @param data Formatted message content
+	 */
+	void store(const MessageSpec& ms, const String& data);
+
+	/**
+	 * @brief Discard templates
+	 * @param object Only discard templates for this object, nullptr for all
+	 */
+	void invalidate(void* object = nullptr);
+
+private:
+	static Key getKey(const MessageSpec& ms)
+	{
+		Key key;
+		key.spec = uint32_t(ms.type()) | (uint32_t(ms.notifySubtype()) << 4) | (uint32_t(ms.match()) << 8) |
+				   (uint32_t(ms.target()) << 12);
+		key.search = ms.searchKey();
+		return key;
+	}
+
+#if SSDP_TEMPLATE_CACHE_SIZE
+	Entry entries[capacity];
+#endif
+	uint32_t useCount{0};
+};
+
+} // namespace SSDP
@@ -0,0 +1,113 @@
+/****
+ * Trace.h - Lightweight event trace for SSDP processing
+ *
+ * Copyright 2019 mikee47 <mike@sillyhouse.net>
+ *
+ * This file is part of the Sming SSDP Library
+ *
+ * This library is free software: you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License as published by the Free Software Foundation, version 3 or later.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this library.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ ****/
+
+#pragma once
+
+#include <WString.h>
+#include <Print.h>
+
+#ifndef SSDP_ENABLE_TRACE
+#define SSDP_ENABLE_TRACE 0
+#endif
+
+#ifndef SSDP_TRACE_SIZE
+#define SSDP_TRACE_SIZE 64
+#endif
+
+/*
+ * Record a trace event for a server instance, compiles to nothing if disabled
+ */
+#if SSDP_ENABLE_TRACE
+#define SSDP_TRACE(instance, event, ...) SSDP::Trace::record(instance, SSDP::Trace::Event::event, ##__VA_ARGS__)
+#else
+#define SSDP_TRACE(instance, event, ...)
+#endif
+
+/*
+ * Trace events with meaning of fields
+ */
+#define SSDP_TRACE_EVENT_MAP(XX)                                                                                       \
+	XX(receive, "-", "length", "address")                                                                              \
+	XX(parse, "type", "error", "headers")                                                                              \
+	XX(drop, "reason", "-", "address")                                                                                 \
+	XX(enqueue, "type", "delay", "object")                                                                             \
+	XX(timer, "type", "queued", "object")                                                                              \
+	XX(build, "type", "match", "object")                                                                               \
+	XX(send, "type", "length", "address")
+
+namespace SSDP
+{
+/**
+ * @brief Fixed-size ring buffer of recent events
+ *
+ * Each event records a clock timestamp and three numeric fields, without formatting
+ * or allocating memory, so tracing can be left enabled under load.
+ * When the buffer is full the oldest events are overwritten.
+ *
+ * There is one buffer shared by all `Server` instances. Each event is tagged with
+ * the instance which recorded it, see `Server::getInstance()`.
+ */
+class Trace
+{
+public:
+	enum class Event : uint8_t {
+#define XX(tag, a, b, c) tag,
+		SSDP_TRACE_EVENT_MAP(XX)
+#undef XX
+	};
+
+	struct Entry {
+		uint32_t ticks; ///< Timer::Clock value when event was recorded
+		Event event;
+		uint8_t instance; ///< Server which recorded the event
+		uint8_t a;
+		uint16_t b;
+		uint32_t c;
+	};
+
+	static constexpr size_t capacity{SSDP_TRACE_SIZE};
+	static_assert((capacity & (capacity - 1)) == 0, "SSDP_TRACE_SIZE must be a power of 2");
+
+	static void record(uint8_t instance, Event event, uint8_t a = 0, uint16_t b = 0, uint32_t c = 0);
+
+	/**
+	 * @brief Copy out recorded events, oldest first
+	 * @param buffer
+	 * @param count Maximum number of entries to read
+	 * @retval unsigned Number of entries read
+	 */
+	static unsigned read(Entry* buffer, unsigned count);
+
+	/**
+	 * @brief Print recorded events in readable form, oldest first
+	 */
+	static size_t dump(Print& p);
+
+	static void clear();
+
+	/**
+	 * @brief Get total number of events recorded, including any overwritten
+	 */
+	static uint32_t total();
+};
+
+} // namespace SSDP
+
+String toString(SSDP::Trace::Event event);
+String toString(const SSDP::Trace::Entry& entry);
@@ -40,7 +40,11 @@
 class Urn
 {
 public:
-	enum class Kind {
+	/**
+	 * @brief Kind of URN
+	 * @note Stored as a single byte as compact structures such as `CompactUrn` embed it
+	 */
+	enum class Kind : uint8_t {
 #define XX(tag, comment) tag,
 		UPNP_URN_KIND_MAP(XX)
 #undef XX
@@ -200,6 +204,117 @@ public:
 
 using Usn = Urn;
 
+/**
+ * @brief Non-owning view of a URN within a text buffer
+ *
+ * Parsing follows the same rules as `Urn::decompose()` but fields refer directly
+ * to the source text, so no memory is allocated. Typically used to inspect ST, NT
+ * and USN values within a received message.
+ *
+ * @note The source text must remain valid for the lifetime of the view.
+ */
+class UrnView
+{
+public:
+	using Kind = Urn::Kind;
+
+	/**
+	 * @brief A field within the source text
+	 */
+	struct Slice {
+		const char* ptr{nullptr};
+		uint16_t length{0};
+
+		Slice()
+		{
+		}
+
+		Slice(const char* ptr, uint16_t length) : ptr(ptr), length(length)
+		{
+		}
+
+		explicit operator bool() const
+		{
+			return length != 0;
+		}
+
+		bool operator==(const String& s) const
+		{
+			return s.length() == length && memcmp(s.c_str(), ptr, length) == 0;
+		}
+
+		bool operator!=(const String& s) const
+		{
+			return !operator==(s);
+		}
+
+		String toString() const
+		{
+			return length ? String(ptr, length) : nullptr;
+		}
+	};
+
+	UrnView()
+	{
+	}
+
+	explicit UrnView(const char* s)
+	{
+		decompose(s);
+	}
+
+	UrnView(const char* s, size_t len)
+	{
+		decompose(s, len);
+	}
+
+	bool decompose(const char* s, size_t len);
+
+	bool decompose(const char* s)
+	{
+		return s ? decompose(s, strlen(s)) : false;
+	}
+
+	/**
+	 * @brief Determine if URN is valid
+	 */
+	explicit operator bool() const
+	{
+		return kind != Kind::none;
+	}
+
+	/**
+	 * @brief Compare with an owning URN, without allocating memory
+	 */
+	bool operator==(const Urn& urn) const;
+
+	bool operator!=(const Urn& urn) const
+	{
+		return !operator==(urn);
+	}
+
+	/**
+	 * @brief Obtain an owning copy of this URN
+	 */
+	Urn toUrn() const;
+
+	Kind kind{};
+	Slice uuid;
+	Slice domain;
+	Slice type;
+	uint8_t version{1};
+};
+
+inline bool operator==(const Urn& urn, const UrnView& view)
+{
+	return view == urn;
+}
+
+inline bool operator!=(const Urn& urn, const UrnView& view)
+{
+	return view != urn;
+}
+
 String toString(Urn::Kind kind);
 
 inline String toString(const Urn& urn)
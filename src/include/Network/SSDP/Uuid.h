@@ -55,17 +55,43 @@ struct Uuid {
 		decompose(s.c_str(), s.length());
 	}
 
-	explicit operator bool()
+	explicit operator bool() const
 	{
-		Uuid Null{};
-		return memcmp(this, &Null, sizeof(Null)) != 0;
+		return time_low != 0 || time_mid != 0 || time_hi_and_version != 0 || clock_seq_hi_and_reserved != 0 ||
+			   clock_seq_low != 0 || node[0] != 0 || node[1] != 0 || node[2] != 0 || node[3] != 0 || node[4] != 0 ||
+			   node[5] != 0;
+	}
+
+	bool operator==(const Uuid& other) const
+	{
+		return memcmp(this, &other, sizeof(Uuid)) == 0;
+	}
+
+	bool operator!=(const Uuid& other) const
+	{
+		return !operator==(other);
 	}
 
+	/**
+	 * @brief Ordering is consistent with that of the string representation
+	 */
+	bool operator<(const Uuid& other) const;
+
+	/**
+	 * @brief Get hash value suitable for use as a container key
+	 */
+	uint32_t hash() const;
+
 	/**
 	 * @note System clock must be set or this will not produce correct results.
 	 */
 	bool generate();
 
+	/**
+	 * @brief Set UUID from string representation
+	 * @retval bool false if string is not in the standard 36-character form, in which case
+	 * the UUID is not changed
+	 */
 	bool decompose(const char* s, size_t len);
 
 	bool decompose(const char* s)
@@ -100,6 +126,8 @@ struct Uuid {
 	}
 };
 
+static_assert(sizeof(Uuid) == 16, "Uuid must be packed");
+
 inline String toString(const Uuid& uuid)
 {
 	return uuid.toString();
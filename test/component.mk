@@ -0,0 +1,15 @@
+COMPONENT_SRCDIRS := app modules
+COMPONENT_INCDIRS := include
+ARDUINO_LIBRARIES := SmingTest SSDP
+
+# Tests don't need a TAP interface; override this to include the UDP socket send benchmark
+HOST_NETWORK_OPTIONS ?= --nonet
+
+# Benchmarks report heap allocations per operation
+ENABLE_MALLOC_COUNT := 1
+
+# Template cache tests need somewhere to store templates
+SSDP_TEMPLATE_CACHE_SIZE := 4
+
+.PHONY: execute
+execute: flash run
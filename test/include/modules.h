@@ -0,0 +1,15 @@
+#pragma once
+
+#define TEST_MAP(XX)                                                                                                   \
+	XX(SearchHistory)                                                                                                  \
+	XX(RetainedMessage)                                                                                                \
+	XX(MessageQueue)                                                                                                   \
+	XX(DeviceRegistry)                                                                                                 \
+	XX(TemplateCache)                                                                                                  \
+	XX(DiscoveryCache)                                                                                                 \
+	XX(RateLimit)                                                                                                      \
+	XX(Uuid)                                                                                                           \
+	XX(Urn)                                                                                                            \
+	XX(SearchIndex)                                                                                                    \
+	XX(Server)                                                                                                         \
+	XX(Benchmark)
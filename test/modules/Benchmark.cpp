@@ -0,0 +1,400 @@
+#include <SmingTest.h>
+#include <Network/SSDP/Server.h>
+#include <Network/SSDP/Urn.h>
+#include <Platform/Station.h>
+#include <malloc_count.h>
+#include <stringconversion.h>
+#include <memory>
+
+/*
+ * Timings for the SSDP hot paths.
+ *
+ * Results are printed as CSV lines prefixed with `BENCH` so they can be extracted from the log:
+ *
+ *   BENCH,name,iterations,ns/op,allocs/op
+ *
+ * Allocation counts come from the malloc_count component and include any MessagePool heap overflow.
+ */
+
+namespace
+{
+DEFINE_FSTR_LOCAL(msearchPacket, "M-SEARCH * HTTP/1.1\r\n"
+								 "HOST: 239.255.255.250:1900\r\n"
+								 "MAN: \"ssdp:discover\"\r\n"
+								 "MX: 1\r\n"
+								 "ST: urn:schemas-upnp-org:device:MediaRenderer:1\r\n"
+								 "USER-AGENT: Linux/5.10 UPnP/1.0 Sming/4.7\r\n"
+								 "\r\n")
+
+DEFINE_FSTR_LOCAL(notifyPacket, "NOTIFY * HTTP/1.1\r\n"
+								"HOST: 239.255.255.250:1900\r\n"
+								"CACHE-CONTROL: max-age=1800\r\n"
+								"LOCATION: http://192.168.1.20:49152/description.xml\r\n"
+								"NT: urn:schemas-upnp-org:service:AVTransport:1\r\n"
+								"NTS: ssdp:alive\r\n"
+								"SERVER: Linux/5.10 UPnP/1.0 Portable SDK for UPnP devices/1.14.0\r\n"
+								"USN: uuid:4d696e69-444c-164e-9d41-b827eb54e3a1::urn:schemas-upnp-org:service:AVTransport:1\r\n"
+								"\r\n")
+
+DEFINE_FSTR_LOCAL(responsePacket, "HTTP/1.1 200 OK\r\n"
+								  "CACHE-CONTROL: max-age=1800\r\n"
+								  "DATE: Fri, 16 Oct 2026 10:00:00 GMT\r\n"
+								  "EXT:\r\n"
+								  "LOCATION: http://192.168.1.30:80/description.xml\r\n"
+								  "SERVER: FreeRTOS/10 UPnP/1.0 Sming/4.7\r\n"
+								  "ST: upnp:rootdevice\r\n"
+								  "USN: uuid:2fac1234-31f8-11b4-a222-08002b34c003::upnp:rootdevice\r\n"
+								  "\r\n")
+
+DEFINE_FSTR_LOCAL(deviceUuid, "2fac1234-31f8-11b4-a222-08002b34c003")
+DEFINE_FSTR_LOCAL(serviceUrn, "urn:schemas-upnp-org:service:ContentDirectory:1")
+
+/*
+ * Uuid codec as it was before the table-driven version, for comparison
+ */
+bool legacyDecompose(Uuid& uuid, const char* s, size_t len)
+{
+	if(len != Uuid::stringSize) {
+		return false;
+	}
+
+	char* p;
+	uuid.time_low = strtoul(s, &p, 16);
+	if(*p != '-' || p - s != 8) {
+		return false;
+	}
+	s = ++p;
+
+	uuid.time_mid = strtoul(s, &p, 16);
+	if(*p != '-' || p - s != 4) {
+		return false;
+	}
+	s = ++p;
+
+	uuid.time_hi_and_version = strtoul(s, &p, 16);
+	if(*p != '-' || p - s != 4) {
+		return false;
+	}
+	s = ++p;
+
+	uint16_t x = strtoul(s, &p, 16);
+	if(*p != '-' || p - s != 4) {
+		return false;
+	}
+	uuid.clock_seq_hi_and_reserved = x >> 8;
+	uuid.clock_seq_low = x & 0xff;
+	s = ++p;
+
+	for(unsigned i = 0; i < sizeof(uuid.node); ++i) {
+		uint8_t c = unhex(*s++) << 4;
+		c |= unhex(*s++);
+		uuid.node[i] = c;
+	}
+
+	return true;
+}
+
+size_t legacyToString(const Uuid& uuid, char* buffer, size_t bufSize)
+{
+	if(buffer == nullptr || bufSize < Uuid::stringSize) {
+		return 0;
+	}
+
+	auto set = [&](unsigned offset, uint32_t value, unsigned digits) {
+		ultoa_wp(value, &buffer[offset], 16, digits, '0');
+	};
+
+	set(0, uuid.time_low, 8);
+	buffer[8] = '-';
+	set(9, uuid.time_mid, 4);
+	buffer[13] = '-';
+	set(14, uuid.time_hi_and_version, 4);
+	buffer[18] = '-';
+	set(19, uuid.clock_seq_hi_and_reserved, 2);
+	set(21, uuid.clock_seq_low, 2);
+	buffer[23] = '-';
+
+	unsigned pos = 24;
+	for(unsigned i = 0; i < 6; ++i) {
+		buffer[pos++] = hexchar(uuid.node[i] >> 4);
+		buffer[pos++] = hexchar(uuid.node[i] & 0x0f);
+	}
+
+	return Uuid::stringSize;
+}
+
+/*
+ * Avoid the compiler discarding results
+ */
+volatile uint32_t sink;
+
+} // namespace
+
+class BenchmarkTest : public TestGroup
+{
+public:
+	BenchmarkTest() : TestGroup(_F("Benchmark")), dispatchQueue(MessageDelegate(&BenchmarkTest::onDispatch, this))
+	{
+	}
+
+	void execute() override
+	{
+		Serial << _F("BENCH,name,iterations,ns/op,allocs/op") << endl;
+
+		TEST_CASE("Parse")
+		{
+			parse(F("msearch"), msearchPacket);
+			parse(F("notify"), notifyPacket);
+			parse(F("response"), responsePacket);
+		}
+
+		TEST_CASE("Uuid codec")
+		{
+			String s(deviceUuid);
+			Uuid uuid;
+			run(F("uuid.decompose"), 10000, [&]() { sink = uuid.decompose(s); });
+			REQUIRE(uuid);
+			char buf[Uuid::stringSize + 1];
+			run(F("uuid.toString"), 10000, [&]() { sink = uuid.toString(buf, sizeof(buf)); });
+			buf[Uuid::stringSize] = '\0';
+			REQUIRE(s == buf);
+			Uuid other(uuid);
+			run(F("uuid.equals"), 10000, [&]() { sink = (uuid == other); });
+
+			// Previous strtoul/unhex decode and ultoa_wp encode give the baseline
+			Uuid legacy;
+			run(F("uuid.decompose.legacy"), 10000, [&]() { sink = legacyDecompose(legacy, s.c_str(), s.length()); });
+			REQUIRE(legacy == uuid);
+			memset(buf, 0, sizeof(buf));
+			run(F("uuid.toString.legacy"), 10000, [&]() { sink = legacyToString(legacy, buf, sizeof(buf)); });
+			REQUIRE(s == buf);
+		}
+
+		TEST_CASE("Urn codec")
+		{
+			String s(serviceUrn);
+			Urn urn;
+			run(F("urn.decompose"), 10000, [&]() { sink = urn.decompose(s); });
+			REQUIRE(urn.kind == Urn::Kind::service);
+			run(F("urn.toString"), 10000, [&]() { sink = urn.toString().length(); });
+			Urn other(urn);
+			run(F("urn.equals"), 10000, [&]() { sink = (urn == other); });
+			run(F("urn.equalsView"), 10000, [&]() {
+				UrnView view(s.c_str(), s.length());
+				sink = (urn == view);
+			});
+		}
+
+		TEST_CASE("Send path")
+		{
+			auto& server = SSDP::server;
+			server.setSendSink([this](IpAddress, uint16_t, const char*, size_t length) {
+				sentBytes += length;
+				return true;
+			});
+
+			SSDP::MessageSpec ms(SSDP::MessageType::response, SSDP::SearchTarget::root, this);
+			ms.setRemote(IpAddress(192, 168, 1, 40), 50000);
+			run(F("buildMessage"), 1000, [&]() {
+				SSDP::Message msg;
+				sink = server.buildMessage(msg, ms);
+			});
+
+			SSDP::Message msg;
+			server.buildMessage(msg, ms);
+			msg["ST"] = SSDP::UPNP_ROOTDEVICE;
+			msg["USN"] = F("uuid:") + deviceUuid + F("::") + SSDP::UPNP_ROOTDEVICE;
+			msg[HTTP_HEADER_LOCATION] = F("http://192.168.1.10/description.xml");
+			sentBytes = 0;
+			run(F("sendMessage.sink"), 1000, [&]() { sink = server.sendMessage(msg); });
+			REQUIRE(sentBytes != 0);
+
+			server.setSendSink(nullptr);
+
+			/*
+			 * Same message via UdpOut and udp_sendto(). This needs a network interface,
+			 * so run with HOST_NETWORK_OPTIONS set to use a TAP device.
+			 * Datagrams go to the discard port on our own address so nothing else sees them.
+			 */
+			auto localIp = WifiStation.getIP();
+			if(!localIp.isNull()) {
+				msg.remoteIP = localIp;
+				msg.remotePort = 9;
+				REQUIRE(server.sendMessage(msg));
+				run(F("sendMessage.udp"), 1000, [&]() { sink = server.sendMessage(msg); });
+
+				/*
+				 * Socket cost alone: a connection bound once for its lifetime, as now used by the server,
+				 * against the previous approach of calling listen(0) before every send.
+				 */
+				String data(responsePacket);
+				UdpConnection udp;
+				REQUIRE(udp.listen(0));
+				run(F("udp.persistent"), 1000, [&]() { sink = udp.sendStringTo(localIp, 9, data); });
+				run(F("udp.listenPerSend"), 1000, [&]() {
+					udp.listen(0);
+					sink = udp.sendStringTo(localIp, 9, data);
+				});
+			} else {
+				Serial << _F("No network interface, skipping sendMessage.udp") << endl;
+			}
+		}
+
+		TEST_CASE("Queue")
+		{
+			for(unsigned count : {10, 100, 1000, 10000}) {
+				queue(count);
+			}
+		}
+
+		TEST_CASE("Dispatch")
+		{
+			/*
+			 * Responses are exempt from the minimum interval, but each dispatch still takes
+			 * one timer callback of at least 1ms. Timings are dominated by that floor so
+			 * this mainly catches changes to how the queue schedules its timer.
+			 */
+			dispatchQueue.setMinimumInterval(0);
+			dispatchCount = 0;
+			for(unsigned i = 0; i < dispatchTotal; ++i) {
+				dispatchQueue.add(newSpec(i), 0);
+			}
+			dispatchAllocs = MallocCount::getAllocCount();
+			dispatchStart = micros();
+			pending();
+		}
+	}
+
+private:
+	using MessageDelegate = SSDP::MessageDelegate;
+
+	static constexpr unsigned dispatchTotal{100};
+
+	template <typename Func> void run(const String& name, unsigned iterations, Func func)
+	{
+		// Warm up caches and any lazily-created state
+		func();
+
+		auto allocs = MallocCount::getAllocCount();
+		auto start = micros();
+		for(unsigned i = 0; i < iterations; ++i) {
+			func();
+		}
+		auto elapsed = micros() - start;
+		allocs = MallocCount::getAllocCount() - allocs;
+		report(name, iterations, elapsed, allocs);
+	}
+
+	void report(const String& name, unsigned iterations, uint32_t elapsedUs, size_t allocs)
+	{
+		auto nsPerOp = uint64_t(elapsedUs) * 1000 / iterations;
+		Serial << _F("BENCH,") << name << ',' << iterations << ',' << uint32_t(nsPerOp) << ','
+			   << String(double(allocs) / iterations, 2) << endl;
+	}
+
+	/*
+	 * Parsing modifies the data so each iteration works on a fresh copy
+	 */
+	void parse(const String& name, const FlashString& packet)
+	{
+		String data(packet);
+		char buf[SSDP_MAX_RECEIVE_SIZE];
+		auto len = data.length();
+		HttpError err{};
+		run(F("parse.") + name, 10000, [&]() {
+			memcpy(buf, data.c_str(), len);
+			SSDP::BasicMessage msg;
+			err = msg.parse(buf, len);
+		});
+		REQUIRE(err == HPE_OK);
+	}
+
+	/*
+	 * Objects and remote addresses vary so the hash indices see a realistic spread
+	 */
+	SSDP::MessageSpec* newSpec(unsigned i)
+	{
+		auto ms = new SSDP::MessageSpec(SSDP::MessageType::response, SSDP::SearchTarget::root, &objects[i % 64]);
+		if(ms != nullptr) {
+			ms->setRemote(IpAddress(192, 168, uint8_t(i >> 8), uint8_t(i)), 1900 + (i % 1000));
+		}
+		return ms;
+	}
+
+	void queue(unsigned count)
+	{
+		SSDP::MessageQueue q(MessageDelegate(&BenchmarkTest::onDispatch, this));
+		String suffix('.');
+		suffix += count;
+
+		// Spread due times across all wheel levels
+		unsigned seed{1};
+		auto interval = [&]() {
+			seed = seed * 1103515245 + 12345;
+			return (seed >> 8) % 300000;
+		};
+
+		// Allocate beforehand so pool overflow to the heap isn't included in the timing
+		std::unique_ptr<SSDP::MessageSpec*[]> specs(new SSDP::MessageSpec*[count]);
+		std::unique_ptr<uint32_t[]> intervals(new uint32_t[count]);
+		for(unsigned i = 0; i < count; ++i) {
+			specs[i] = newSpec(i);
+			intervals[i] = interval();
+		}
+
+		auto allocs = MallocCount::getAllocCount();
+		auto start = micros();
+		for(unsigned i = 0; i < count; ++i) {
+			q.add(specs[i], intervals[i]);
+		}
+		auto elapsed = micros() - start;
+		report(F("queue.add") + suffix, count, elapsed, MallocCount::getAllocCount() - allocs);
+		REQUIRE_EQ(q.count(), count);
+
+		// Look up queued messages in turn
+		unsigned probe{0};
+		unsigned found{0};
+		run(F("queue.contains") + suffix, 1000, [&]() {
+			auto i = probe++ % count;
+			SSDP::MessageSpec ms(SSDP::MessageType::response, SSDP::SearchTarget::root, &objects[i % 64]);
+			ms.setRemote(IpAddress(192, 168, uint8_t(i >> 8), uint8_t(i)), 1900 + (i % 1000));
+			found += q.contains(ms);
+		});
+		REQUIRE_EQ(found, probe);
+
+		// Each object owns count / 64 messages
+		allocs = MallocCount::getAllocCount();
+		start = micros();
+		unsigned removed{0};
+		for(auto& obj : objects) {
+			removed += q.remove(&obj);
+		}
+		elapsed = micros() - start;
+		report(F("queue.remove") + suffix, count, elapsed, MallocCount::getAllocCount() - allocs);
+		REQUIRE_EQ(removed, count);
+		REQUIRE_EQ(q.count(), 0U);
+	}
+
+	void onDispatch(SSDP::MessageSpec* ms)
+	{
+		delete ms;
+		if(++dispatchCount != dispatchTotal) {
+			return;
+		}
+		auto elapsed = micros() - dispatchStart;
+		report(F("queue.dispatch"), dispatchTotal, elapsed, MallocCount::getAllocCount() - dispatchAllocs);
+		complete();
+	}
+
+	SSDP::MessageQueue dispatchQueue;
+	unsigned dispatchCount{0};
+	size_t dispatchAllocs{0};
+	uint32_t dispatchStart{0};
+	size_t sentBytes{0};
+	uint8_t objects[64]{};
+};
+
+void REGISTER_TEST(Benchmark)
+{
+	registerGroup<BenchmarkTest>();
+}
@@ -0,0 +1,138 @@
+#include <SmingTest.h>
+#include <Network/SSDP/DeviceRegistry.h>
+
+namespace
+{
+using SSDP::DeviceRegistry;
+
+/*
+ * Generate distinct UUIDs which hash to the given slot of a table at its initial size,
+ * so tests can arrange probe chains
+ */
+class UuidGenerator
+{
+public:
+	Uuid next(unsigned home)
+	{
+		Uuid uuid;
+		uuid.time_hi_and_version = 0x1000;
+		do {
+			uuid.time_low = ++sequence;
+		} while(uuid.hash() % DeviceRegistry::initialCapacity != home);
+		return uuid;
+	}
+
+private:
+	uint32_t sequence{0};
+};
+
+} // namespace
+
+class DeviceRegistryTest : public TestGroup
+{
+public:
+	DeviceRegistryTest() : TestGroup(_F("DeviceRegistry"))
+	{
+	}
+
+	void execute() override
+	{
+		if(DeviceRegistry::initialCapacity < 4) {
+			Serial << _F("Registry too small, skipping") << endl;
+			return;
+		}
+
+		constexpr unsigned last = DeviceRegistry::initialCapacity - 1;
+
+		TEST_CASE("Remove object with wrapped probe chain")
+		{
+			/*
+			 * All four entries hash to the last slot, so the chain runs from there through slots 0, 1 and 2.
+			 * Removing the entry in slot 0 moves the third entry back into it, after which removing
+			 * the entry in the last slot pulls that one round to the end of the table, behind the scan.
+			 */
+			UuidGenerator gen;
+			Uuid ids[]{gen.next(last), gen.next(last), gen.next(last), gen.next(last)};
+			void* owners[]{&objects[0], &objects[0], &objects[0], &objects[1]};
+			DeviceRegistry reg;
+			for(unsigned i = 0; i < 4; ++i) {
+				REQUIRE(reg.add(ids[i], owners[i]));
+			}
+			REQUIRE_EQ(reg.count(), 4U);
+
+			reg.remove(&objects[0]);
+			REQUIRE_EQ(reg.count(), 1U);
+			for(unsigned i = 0; i < 4; ++i) {
+				REQUIRE(reg.find(ids[i]) == ((owners[i] == &objects[0]) ? nullptr : owners[i]));
+			}
+
+			reg.remove(&objects[1]);
+			REQUIRE_EQ(reg.count(), 0U);
+			REQUIRE(reg.find(ids[2]) == nullptr);
+		}
+
+		TEST_CASE("Remove object from crowded table")
+		{
+			// Fill to just below the point at which the table grows, with chains from the last two slots
+			// wrapping round and owners alternating
+			constexpr unsigned count = DeviceRegistry::initialCapacity * 3 / 4;
+			UuidGenerator gen;
+			Uuid ids[count];
+			DeviceRegistry reg;
+			for(unsigned i = 0; i < count; ++i) {
+				ids[i] = gen.next(last - (i % 2));
+				REQUIRE(reg.add(ids[i], &objects[i % 2]));
+			}
+			REQUIRE_EQ(reg.count(), count);
+			REQUIRE_EQ(reg.capacity(), DeviceRegistry::initialCapacity);
+
+			reg.remove(&objects[1]);
+			REQUIRE_EQ(reg.count(), (count + 1) / 2);
+			for(unsigned i = 0; i < count; ++i) {
+				REQUIRE(reg.find(ids[i]) == ((i % 2) ? nullptr : &objects[0]));
+			}
+
+			// Freed slots are usable again
+			REQUIRE(reg.add(gen.next(last), &objects[1]));
+		}
+
+		TEST_CASE("Growth")
+		{
+			constexpr unsigned count = 200;
+			UuidGenerator gen;
+			auto ids = new Uuid[count];
+			DeviceRegistry reg;
+			for(unsigned i = 0; i < count; ++i) {
+				ids[i] = gen.next(i % DeviceRegistry::initialCapacity);
+				REQUIRE(reg.add(ids[i], &objects[i % 2]));
+			}
+			REQUIRE_EQ(reg.count(), count);
+			REQUIRE(reg.capacity() * 3 >= count * 4);
+
+			// Updating an existing device doesn't add an entry
+			REQUIRE(reg.add(ids[0], &objects[1]));
+			REQUIRE_EQ(reg.count(), count);
+			REQUIRE(reg.add(ids[0], &objects[0]));
+
+			reg.remove(&objects[1]);
+			REQUIRE_EQ(reg.count(), count / 2);
+			for(unsigned i = 0; i < count; ++i) {
+				REQUIRE(reg.find(ids[i]) == ((i % 2) ? nullptr : &objects[0]));
+			}
+
+			reg.clear();
+			REQUIRE_EQ(reg.count(), 0U);
+			REQUIRE_EQ(reg.capacity(), DeviceRegistry::initialCapacity);
+			REQUIRE(reg.find(ids[0]) == nullptr);
+			delete[] ids;
+		}
+	}
+
+private:
+	uint8_t objects[2]{};
+};
+
+void REGISTER_TEST(DeviceRegistry)
+{
+	registerGroup<DeviceRegistryTest>();
+}
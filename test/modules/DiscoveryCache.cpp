@@ -0,0 +1,218 @@
+#include <SmingTest.h>
+#include <Network/SSDP/DiscoveryCache.h>
+
+namespace
+{
+using SSDP::DiscoveryCache;
+using Event = DiscoveryCache::Event;
+
+/*
+ * Parsed NOTIFY message. Headers refer into `data` so this must not be copied.
+ */
+class Advert
+{
+public:
+	Advert(const char* usn, const char* location, unsigned maxAge, const char* nts)
+	{
+		data = F("NOTIFY * HTTP/1.1\r\n"
+				 "HOST: 239.255.255.250:1900\r\n"
+				 "NT: upnp:rootdevice\r\n");
+		data += F("NTS: ");
+		data += nts;
+		data += F("\r\nUSN: ");
+		data += usn;
+		data += F("\r\nLOCATION: ");
+		data += location;
+		data += F("\r\nCACHE-CONTROL: max-age=");
+		data += maxAge;
+		data += F("\r\n\r\n");
+		msg.parse(data.begin(), data.length());
+	}
+
+	Advert(const Advert&) = delete;
+
+	String data;
+	SSDP::BasicMessage msg;
+};
+
+bool alive(DiscoveryCache& cache, const char* usn, const char* location = "http://192.168.1.10/",
+		   unsigned maxAge = 1800)
+{
+	return cache.update(Advert(usn, location, maxAge, "ssdp:alive").msg);
+}
+
+bool byebye(DiscoveryCache& cache, const char* usn)
+{
+	return cache.update(Advert(usn, "", 0, "ssdp:byebye").msg);
+}
+
+} // namespace
+
+class DiscoveryCacheTest : public TestGroup
+{
+public:
+	DiscoveryCacheTest() : TestGroup(_F("DiscoveryCache"))
+	{
+	}
+
+	void execute() override
+	{
+		TEST_CASE("Add, refresh, change and remove")
+		{
+			DiscoveryCache cache;
+			watch(cache);
+
+			REQUIRE(alive(cache, "uuid:a"));
+			REQUIRE(events == "added:uuid:a ");
+			REQUIRE_EQ(cache.count(), 1U);
+
+			// Same content only refreshes the expiry time
+			REQUIRE(alive(cache, "uuid:a"));
+			REQUIRE(events == "added:uuid:a ");
+
+			REQUIRE(alive(cache, "uuid:a", "http://192.168.1.11/"));
+			REQUIRE(events == "added:uuid:a changed:uuid:a ");
+			auto e = cache.find("uuid:a");
+			REQUIRE(e != nullptr);
+			REQUIRE(strcmp(e->location(), "http://192.168.1.11/") == 0);
+			REQUIRE(strcmp(e->type(), "upnp:rootdevice") == 0);
+
+			REQUIRE(byebye(cache, "uuid:a"));
+			REQUIRE(events == "added:uuid:a changed:uuid:a removed:uuid:a ");
+			REQUIRE_EQ(cache.count(), 0U);
+			REQUIRE(cache.find("uuid:a") == nullptr);
+			REQUIRE(!cache.remove("uuid:a"));
+		}
+
+		TEST_CASE("Expiry")
+		{
+			DiscoveryCache cache;
+			watch(cache);
+			alive(cache, "uuid:a", "http://192.168.1.10/", 0);
+			alive(cache, "uuid:b");
+			REQUIRE(cache.find("uuid:a") == nullptr);
+			REQUIRE(cache.find("uuid:b") != nullptr);
+
+			events = "";
+			cache.expire();
+			REQUIRE(events == "removed:uuid:a ");
+			REQUIRE_EQ(cache.count(), 1U);
+		}
+
+		TEST_CASE("Cache full")
+		{
+			DiscoveryCache cache(2);
+			watch(cache);
+			alive(cache, "uuid:a");
+			alive(cache, "uuid:b");
+			alive(cache, "uuid:c");
+			REQUIRE_EQ(cache.count(), 2U);
+			REQUIRE(cache.find("uuid:c") == nullptr);
+
+			// Existing entries may still change
+			REQUIRE(alive(cache, "uuid:b", "http://192.168.1.11/"));
+			REQUIRE(events == "added:uuid:a added:uuid:b changed:uuid:b ");
+		}
+
+		TEST_CASE("Modify cache from removal callback")
+		{
+			/*
+			 * Expiry of the first entry removes one live entry and adds another.
+			 * The other expired entries must still be reported, once each.
+			 */
+			DiscoveryCache cache;
+			const char* expiring[]{"uuid:a", "uuid:b", "uuid:c"};
+			for(auto usn : expiring) {
+				alive(cache, usn, "http://192.168.1.10/", 0);
+			}
+			alive(cache, "uuid:d");
+			alive(cache, "uuid:e");
+			REQUIRE_EQ(cache.count(), 5U);
+
+			unsigned removed{0};
+			cache.onEvent([&](Event event, const DiscoveryCache::Entry& entry) {
+				if(event != Event::removed) {
+					return;
+				}
+				// Entry remains intact for the duration of the callback
+				REQUIRE(strcmp(entry.location(), "http://192.168.1.10/") == 0);
+				if(removed++ == 0) {
+					REQUIRE(cache.remove("uuid:e"));
+					REQUIRE(alive(cache, "uuid:f"));
+				}
+			});
+			cache.expire();
+			REQUIRE_EQ(removed, 4U);
+			REQUIRE_EQ(cache.count(), 2U);
+			REQUIRE(cache.find("uuid:d") != nullptr);
+			REQUIRE(cache.find("uuid:f") != nullptr);
+			unsigned count{0};
+			cache.forEach([&](const DiscoveryCache::Entry&) { ++count; });
+			REQUIRE_EQ(count, 2U);
+
+			// Clearing from a callback stops further notifications
+			alive(cache, "uuid:a", "http://192.168.1.10/", 0);
+			alive(cache, "uuid:b", "http://192.168.1.10/", 0);
+			removed = 0;
+			cache.onEvent([&](Event event, const DiscoveryCache::Entry&) {
+				if(event == Event::removed) {
+					++removed;
+					cache.clear();
+				}
+			});
+			cache.expire();
+			REQUIRE_EQ(removed, 1U);
+			REQUIRE_EQ(cache.count(), 0U);
+			REQUIRE(alive(cache, "uuid:a"));
+			REQUIRE(cache.find("uuid:a") != nullptr);
+		}
+
+		TEST_CASE("Arena compaction")
+		{
+			// Each change leaves the old entry behind, so the arena must be compacted to make room
+			DiscoveryCache cache(4, 256);
+			alive(cache, "uuid:a");
+			alive(cache, "uuid:b");
+			for(unsigned i = 0; i < 20; ++i) {
+				String location = F("http://192.168.1.10/");
+				location += i;
+				REQUIRE(alive(cache, "uuid:a", location.c_str()));
+				auto e = cache.find("uuid:a");
+				REQUIRE(e != nullptr);
+				REQUIRE(location == e->location());
+			}
+			REQUIRE_EQ(cache.count(), 2U);
+			REQUIRE(cache.find("uuid:b") != nullptr);
+
+			// Entries too large for the arena are ignored
+			String usn = F("uuid:");
+			while(usn.length() < 300) {
+				usn += 'x';
+			}
+			alive(cache, usn.c_str());
+			REQUIRE_EQ(cache.count(), 2U);
+		}
+	}
+
+private:
+	/*
+	 * Record events as a string, e.g. "added:uuid:a removed:uuid:a "
+	 */
+	void watch(DiscoveryCache& cache)
+	{
+		events = "";
+		cache.onEvent([this](Event event, const DiscoveryCache::Entry& entry) {
+			events += toString(event);
+			events += ':';
+			events += entry.usn();
+			events += ' ';
+		});
+	}
+
+	String events;
+};
+
+void REGISTER_TEST(DiscoveryCache)
+{
+	registerGroup<DiscoveryCacheTest>();
+}
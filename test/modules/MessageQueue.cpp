@@ -0,0 +1,259 @@
+#include <SmingTest.h>
+#include <Network/SSDP/MessageQueue.h>
+#include <algorithm>
+#include <vector>
+
+namespace SSDP
+{
+/*
+ * Most cases step the timer wheel directly so that delays of many minutes, and wrap of the
+ * jiffy counter, can be checked without waiting. Nothing yields to the scheduler there,
+ * so the queue timer never fires.
+ */
+class MessageQueueTest : public TestGroup
+{
+public:
+	MessageQueueTest() : TestGroup(_F("MessageQueue")), timerQueue(MessageDelegate(&MessageQueueTest::onDispatch, this))
+	{
+	}
+
+	void execute() override
+	{
+		TEST_CASE("Dispatch ordering")
+		{
+			check(0, {40, 3, 1100, 17, 1, 31, 32, 33, 700});
+		}
+
+		TEST_CASE("Cascade across level boundaries")
+		{
+			// Just before a level 1 block boundary
+			check(MessageQueue::wheelSize - 2, {1, 2, 3, 31, 32, 33, 64});
+			// Just before a level 2 block boundary
+			check((MessageQueue::wheelSize * MessageQueue::wheelSize) - 3, {2, 3, 4, 29, 30, 1023, 1024, 1025, 5000});
+		}
+
+		TEST_CASE("Delay beyond wheel span")
+		{
+			constexpr uint32_t span = MessageQueue::wheelSpan;
+			check(0, {span - 1, span, span + 1, span + 100, 3 * span + 7, 10});
+			check(12345, {span + 999, 2 * span - 1, 2 * span, 5});
+		}
+
+		TEST_CASE("Delay beyond clock range")
+		{
+			/*
+			 * One day, and the longest interval add() accepts (about 49.7 days), exceed the range
+			 * of a 32-bit clock tick count at any likely clock rate, so must not be converted to ticks.
+			 */
+			check(0, {8640000, 429496729, 3});
+		}
+
+		TEST_CASE("Wrap of current")
+		{
+			check(0xffffffff - 50, {10, 50, 51, 52, 60, 2000, 40000});
+			check(0xffffffff, {1, 2, 32, 1024});
+		}
+
+		TEST_CASE("Remove from wheel and ready list")
+		{
+			MessageQueue q(MessageDelegate(&MessageQueueTest::onDispatch, this));
+			setCurrent(q, 100);
+			uint32_t intervals[]{5, 20, 40, 2000, 50000};
+			for(auto j : intervals) {
+				add(q, &objects[0], j);
+				add(q, &objects[1], j + 1);
+			}
+			REQUIRE_EQ(q.count(), 10U);
+
+			// First four are now on the ready list, the rest spread across the wheel
+			q.advance(100 + 21);
+			REQUIRE_EQ(readyCount(q), 4U);
+
+			REQUIRE_EQ(q.remove(&objects[0]), 5U);
+			REQUIRE_EQ(q.count(), 5U);
+			REQUIRE_EQ(readyCount(q), 2U);
+			REQUIRE_EQ(q.remove(&objects[0]), 0U);
+
+			// Only the other object's messages remain, and still fall due at the right time
+			for(unsigned i = 0; i < 2; ++i) {
+				auto ms = pop(q);
+				REQUIRE(ms != nullptr && ms->object<void>() == &objects[1]);
+				delete ms;
+			}
+			for(auto j : intervals) {
+				uint32_t due = 100 + j + 1;
+				if(due <= 100 + 21) {
+					continue;
+				}
+				q.advance(due - 1);
+				REQUIRE_EQ(readyCount(q), 0U);
+				q.advance(due);
+				auto ms = pop(q);
+				REQUIRE(ms != nullptr && ms->object<void>() == &objects[1]);
+				delete ms;
+			}
+			REQUIRE_EQ(q.count(), 0U);
+			REQUIRE_EQ(q.wheelCount, 0U);
+		}
+
+		TEST_CASE("Remove by message type")
+		{
+			MessageQueue q(MessageDelegate(&MessageQueueTest::onDispatch, this));
+			setCurrent(q, 0);
+			add(q, &objects[0], 10, MessageType::notify);
+			add(q, &objects[0], 11, MessageType::response);
+			add(q, &objects[0], 5000, MessageType::response);
+			REQUIRE_EQ(q.remove(&objects[0], getMask(MessageType::response)), 2U);
+			REQUIRE_EQ(q.count(), 1U);
+			q.advance(10);
+			auto ms = pop(q);
+			REQUIRE(ms != nullptr);
+			REQUIRE(ms->type() == MessageType::notify);
+			delete ms;
+		}
+
+#if SSDP_ENABLE_STATS
+		TEST_CASE("Receive time stamping")
+		{
+			MessageQueue q(MessageDelegate(&MessageQueueTest::onDispatch, this));
+			setCurrent(q, 0);
+			// A tick count of zero is a valid receive time
+			q.setReceiveTime(0);
+			add(q, &objects[0], 10, MessageType::response);
+			add(q, &objects[0], 10, MessageType::notify);
+			q.clearReceiveTime();
+			add(q, &objects[1], 10, MessageType::response);
+			q.advance(10);
+			for(unsigned i = 0; i < 3; ++i) {
+				auto ms = pop(q);
+				REQUIRE(ms != nullptr);
+				bool stamped = (ms->object<void>() == &objects[0] && ms->type() == MessageType::response);
+				REQUIRE_EQ(ms->hasReceived(), stamped);
+				if(stamped) {
+					REQUIRE_EQ(ms->received(), 0U);
+				}
+				delete ms;
+			}
+		}
+#endif
+
+		TEST_CASE("Timer dispatch")
+		{
+			// Responses are exempt from the minimum interval so go out as each falls due
+			for(unsigned i = 0; i < timerCount; ++i) {
+				auto ms = new MessageSpec(MessageType::response, SearchTarget::root, &objects[i]);
+				timerQueue.add(ms, timerIntervals[i]);
+			}
+			timerDispatched = 0;
+			pending();
+		}
+	}
+
+private:
+	static constexpr unsigned timerCount{5};
+	static constexpr uint16_t timerIntervals[timerCount]{80, 20, 140, 50, 110};
+
+	/*
+	 * Set position of an empty queue's wheel
+	 */
+	static void setCurrent(MessageQueue& q, uint32_t jiffy)
+	{
+		q.current = jiffy;
+		q.currentTicks = Timer::Clock::ticks();
+	}
+
+	/*
+	 * Queue a message to fall due the given number of jiffies from `current`.
+	 * Asking for half a jiffy less than that leaves room for the clock to advance during the call.
+	 */
+	static void add(MessageQueue& q, void* object, uint32_t jiffies, MessageType type = MessageType::response)
+	{
+		auto ms = new MessageSpec(type, SearchTarget::root, object);
+		q.currentTicks = Timer::Clock::ticks();
+		q.add(ms, jiffies * MessageQueue::resolutionMs - MessageQueue::resolutionMs / 2);
+	}
+
+	/*
+	 * Take the next message from the ready list, as the timer callback would
+	 */
+	static MessageSpec* pop(MessageQueue& q)
+	{
+		if(q.readyHead == MessageQueue::none) {
+			return nullptr;
+		}
+		auto ms = MessageQueue::get(q.readyHead);
+		q.unlink(ms);
+		q.unindex(ms);
+		--q.itemCount;
+		return ms;
+	}
+
+	/*
+	 * Messages which have left the wheel but not yet been taken
+	 */
+	static unsigned readyCount(const MessageQueue& q)
+	{
+		return q.itemCount - q.wheelCount;
+	}
+
+	/*
+	 * Queue one message per interval (in jiffies, all distinct) starting at the given wheel position,
+	 * then step through the wheel checking each becomes ready at exactly the right time and in order.
+	 */
+	void check(uint32_t start, std::initializer_list<uint32_t> intervals)
+	{
+		MessageQueue q(MessageDelegate(&MessageQueueTest::onDispatch, this));
+		setCurrent(q, start);
+		for(auto j : intervals) {
+			add(q, reinterpret_cast<void*>(uintptr_t(j)), j);
+		}
+		REQUIRE_EQ(q.count(), intervals.size());
+
+		std::vector<uint32_t> sorted(intervals);
+		std::sort(sorted.begin(), sorted.end());
+		for(auto j : sorted) {
+			uint32_t due = start + j;
+			q.advance(due - 1);
+			REQUIRE(q.readyHead == MessageQueue::none);
+			q.advance(due);
+			auto ms = pop(q);
+			REQUIRE(ms != nullptr);
+			if(ms == nullptr) {
+				break;
+			}
+			REQUIRE_EQ(ms->object<void>(), reinterpret_cast<void*>(uintptr_t(j)));
+			REQUIRE(q.readyHead == MessageQueue::none);
+			delete ms;
+		}
+		REQUIRE_EQ(q.count(), 0U);
+		REQUIRE_EQ(q.wheelCount, 0U);
+	}
+
+	void onDispatch(MessageSpec* ms)
+	{
+		auto i = ms->object<uint8_t>() - objects;
+		delete ms;
+
+		// Each must come after all those with shorter intervals
+		auto interval = timerIntervals[i];
+		auto earlier = std::count_if(std::begin(timerIntervals), std::end(timerIntervals),
+									 [interval](uint16_t t) { return t < interval; });
+		REQUIRE_EQ(unsigned(earlier), timerDispatched);
+		if(++timerDispatched == timerCount) {
+			complete();
+		}
+	}
+
+	MessageQueue timerQueue;
+	unsigned timerDispatched{0};
+	uint8_t objects[timerCount]{};
+};
+
+constexpr uint16_t MessageQueueTest::timerIntervals[];
+
+} // namespace SSDP
+
+void REGISTER_TEST(MessageQueue)
+{
+	registerGroup<SSDP::MessageQueueTest>();
+}
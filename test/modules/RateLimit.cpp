@@ -0,0 +1,97 @@
+#include <SmingTest.h>
+#include <Network/SSDP/RateLimit.h>
+
+namespace
+{
+using SSDP::RateLimit;
+using SSDP::TokenBucket;
+
+/*
+ * Allow for the clock advancing during a test step
+ */
+bool near(uint32_t actual, uint32_t expected, uint32_t margin = 30)
+{
+	return actual <= expected && actual + margin >= expected;
+}
+
+} // namespace
+
+class RateLimitTest : public TestGroup
+{
+public:
+	RateLimitTest() : TestGroup(_F("RateLimit"))
+	{
+	}
+
+	void execute() override
+	{
+		TEST_CASE("Unlimited")
+		{
+			TokenBucket bucket;
+			REQUIRE_EQ(bucket.wait(1000), 0U);
+			bucket.consume(1000);
+			REQUIRE_EQ(bucket.wait(1000), 0U);
+		}
+
+		TEST_CASE("Burst and refill")
+		{
+			// Starts full, with one second's worth of tokens
+			TokenBucket bucket;
+			bucket.setRate(10);
+			REQUIRE_EQ(bucket.wait(10), 0U);
+			REQUIRE(bucket.wait(11) != 0);
+
+			bucket.consume(10);
+			auto wait = bucket.wait(1);
+			REQUIRE(near(wait, 100));
+
+			delay(wait);
+			REQUIRE_EQ(bucket.wait(1), 0U);
+
+			// Never holds more than one second's worth
+			delay(1500);
+			REQUIRE_EQ(bucket.wait(10), 0U);
+			REQUIRE(bucket.wait(11) != 0);
+		}
+
+		TEST_CASE("Debt")
+		{
+			TokenBucket bucket;
+			bucket.setRate(10);
+			bucket.consume(15);
+			REQUIRE(near(bucket.wait(0), 500));
+			REQUIRE(near(bucket.wait(1), 600));
+
+			// Debt is repaid at the refill rate
+			delay(250);
+			REQUIRE(near(bucket.wait(0), 250));
+
+			// A long gap is credited as elapsed time, so a large debt is not written off
+			bucket.consume(20);
+			delay(1100);
+			REQUIRE(near(bucket.wait(0), 1150, 60));
+		}
+
+		TEST_CASE("Packets and bytes")
+		{
+			RateLimit limit;
+			limit.packets.setRate(2);
+			limit.bytes.setRate(100);
+			REQUIRE_EQ(limit.wait(), 0U);
+
+			// Byte debt holds back the next message even though a packet token is available
+			limit.consume(150);
+			REQUIRE(near(limit.wait(), 500));
+
+			// Packet limit applies once both tokens are used, even with bytes to spare
+			limit.bytes.setRate(0);
+			limit.consume(1);
+			REQUIRE(near(limit.wait(), 500));
+		}
+	}
+};
+
+void REGISTER_TEST(RateLimit)
+{
+	registerGroup<RateLimitTest>();
+}
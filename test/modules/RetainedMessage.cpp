@@ -0,0 +1,107 @@
+#include <SmingTest.h>
+#include <Network/SSDP/RetainedMessage.h>
+
+namespace
+{
+/*
+ * Build and parse a NOTIFY with the given number of extra headers, each with a value of `valueLength` characters.
+ * Headers refer into `data` so this must not be copied.
+ */
+class Notify
+{
+public:
+	Notify(unsigned extraHeaders, unsigned valueLength = 1)
+	{
+		data = F("NOTIFY * HTTP/1.1\r\n"
+				 "HOST: 239.255.255.250:1900\r\n"
+				 "NTS: ssdp:alive\r\n");
+		String value;
+		value.reserve(valueLength);
+		while(value.length() < valueLength) {
+			value += 'x';
+		}
+		for(unsigned i = 0; i < extraHeaders; ++i) {
+			data += "X-";
+			data += i;
+			data += ": ";
+			data += value;
+			data += "\r\n";
+		}
+		data += "\r\n";
+		err = msg.parse(data.begin(), data.length());
+	}
+
+	Notify(const Notify&) = delete;
+
+	String data;
+	SSDP::BasicMessage msg;
+	HttpError err;
+};
+
+} // namespace
+
+class RetainedMessageTest : public TestGroup
+{
+public:
+	RetainedMessageTest() : TestGroup(_F("RetainedMessage"))
+	{
+	}
+
+	void execute() override
+	{
+		TEST_CASE("Empty message")
+		{
+			SSDP::RetainedMessage msg;
+			REQUIRE(!msg);
+			REQUIRE_EQ(msg.count(), 0U);
+			REQUIRE(msg["NTS"] == nullptr);
+			REQUIRE(msg[SSDP::HeaderId::nts] == nullptr);
+			REQUIRE(msg[0U].name == nullptr);
+		}
+
+		TEST_CASE("Copy headers")
+		{
+			Notify notify(2);
+			REQUIRE(notify.err == HPE_OK);
+			SSDP::RetainedMessage msg(notify.msg);
+			REQUIRE(msg);
+			REQUIRE_EQ(msg.count(), notify.msg.count());
+			REQUIRE(strcmp(msg["nts"], "ssdp:alive") == 0);
+			REQUIRE(strcmp(msg[SSDP::HeaderId::nts], "ssdp:alive") == 0);
+			REQUIRE(strcmp(msg["X-1"], "x") == 0);
+			REQUIRE(msg["X-2"] == nullptr);
+		}
+
+		TEST_CASE("Too many headers")
+		{
+			// Headers must never be silently dropped: either all are kept or assign() fails
+			Notify notify(SSDP::RetainedMessage::maxHeaders);
+			SSDP::RetainedMessage msg;
+			if(notify.msg.count() > SSDP::RetainedMessage::maxHeaders) {
+				REQUIRE(!msg.assign(notify.msg));
+				REQUIRE(!msg);
+				REQUIRE(msg["NTS"] == nullptr);
+			} else {
+				REQUIRE(msg.assign(notify.msg));
+				REQUIRE_EQ(msg.count(), notify.msg.count());
+			}
+		}
+
+		TEST_CASE("Too large")
+		{
+			// Total size exceeds 64KB but is within the HTTP parser header limit
+			Notify notify(3, 22000);
+			REQUIRE(notify.err == HPE_OK);
+			SSDP::RetainedMessage msg;
+			REQUIRE(!msg.assign(notify.msg));
+			REQUIRE(!msg);
+			REQUIRE(msg["X-0"] == nullptr);
+			REQUIRE(msg[SSDP::HeaderId::nts] == nullptr);
+		}
+	}
+};
+
+void REGISTER_TEST(RetainedMessage)
+{
+	registerGroup<RetainedMessageTest>();
+}
@@ -0,0 +1,89 @@
+#include <SmingTest.h>
+#include <Network/SSDP/SearchHistory.h>
+
+namespace
+{
+/*
+ * Parsed M-SEARCH request. Headers refer into `data` so this must not be copied.
+ */
+class Request
+{
+public:
+	Request(const String& st, uint16_t port = 1900)
+	{
+		data = F("M-SEARCH * HTTP/1.1\r\n"
+				 "HOST: 239.255.255.250:1900\r\n"
+				 "MAN: \"ssdp:discover\"\r\n"
+				 "MX: 1\r\n"
+				 "ST: ");
+		data += st;
+		data += "\r\n\r\n";
+		msg.parse(data.begin(), data.length());
+		msg.remoteIP = IpAddress(192, 168, 1, 10);
+		msg.remotePort = port;
+	}
+
+	Request(const Request&) = delete;
+
+	String data;
+	SSDP::BasicMessage msg;
+};
+
+} // namespace
+
+class SearchHistoryTest : public TestGroup
+{
+public:
+	SearchHistoryTest() : TestGroup(_F("SearchHistory"))
+	{
+	}
+
+	void execute() override
+	{
+		Request req1(SSDP::SSDP_ALL);
+		Request req2(SSDP::UPNP_ROOTDEVICE);
+		Request req3(SSDP::SSDP_ALL, 1901);
+
+		TEST_CASE("Disabled by default")
+		{
+			SSDP::SearchHistory history;
+			REQUIRE(!history.check(req1.msg));
+			REQUIRE(!history.check(req1.msg));
+			REQUIRE_EQ(history.suppressed(), 0U);
+		}
+
+		TEST_CASE("Duplicates within window")
+		{
+			SSDP::SearchHistory history;
+			history.setWindow(windowMs);
+			REQUIRE(!history.check(req1.msg));
+			REQUIRE(history.check(req1.msg));
+			REQUIRE(!history.check(req2.msg));
+			REQUIRE(!history.check(req3.msg));
+			REQUIRE(history.check(req2.msg));
+			REQUIRE_EQ(history.suppressed(), 2U);
+		}
+
+		TEST_CASE("Window expiry")
+		{
+			SSDP::SearchHistory history;
+			history.setWindow(windowMs);
+			REQUIRE(!history.check(req1.msg));
+			delay(windowMs * 3 / 5);
+			REQUIRE(history.check(req1.msg));
+			// Window runs from first request, so the repeat above must not have extended it
+			delay(windowMs * 3 / 5);
+			REQUIRE(!history.check(req1.msg));
+			REQUIRE(history.check(req1.msg));
+			REQUIRE_EQ(history.suppressed(), 2U);
+		}
+	}
+
+private:
+	static constexpr uint16_t windowMs{200};
+};
+
+void REGISTER_TEST(SearchHistory)
+{
+	registerGroup<SearchHistoryTest>();
+}
@@ -0,0 +1,226 @@
+#include <SmingTest.h>
+#include <Network/SSDP/SearchIndex.h>
+
+namespace
+{
+using SSDP::MessageSpec;
+using SSDP::MessageType;
+using SSDP::SearchIndex;
+using SSDP::SearchMatch;
+using SSDP::SearchTarget;
+
+/*
+ * Cursor layout, as described in SearchIndex.cpp
+ */
+constexpr uint32_t cursorBucket{0xff00};
+constexpr uint32_t cursorAll{1U << 30};
+constexpr uint32_t cursorValid{1U << 31};
+
+uint32_t getCursor(const MessageSpec& plan)
+{
+	return uint32_t(uintptr_t(plan.cursor<void>()));
+}
+
+/*
+ * Slots are filled in order, so index of an object in `objects` is also its table position
+ */
+template <size_t N> unsigned indexOf(const uint8_t (&objects)[N], const MessageSpec& ms)
+{
+	return ms.object<uint8_t>() - objects;
+}
+
+// UPnP 1.0 places no requirement on UUID format
+DEFINE_FSTR_LOCAL(legacyDeviceUrn, "uuid:Upnp-Widget-1_0-1234567890001::urn:test-index-org:device:Widget:1")
+
+} // namespace
+
+class SearchIndexTest : public TestGroup
+{
+public:
+	SearchIndexTest() : TestGroup(_F("SearchIndex"))
+	{
+	}
+
+	void execute() override
+	{
+		if(SearchIndex::capacity < 4) {
+			Serial << _F("Index too small, skipping") << endl;
+			return;
+		}
+
+		TEST_CASE("Lookup")
+		{
+			SearchIndex index;
+			populate(index);
+
+			MessageSpec plan(MessageType::response);
+			REQUIRE_EQ(index.find(nullptr, plan), 0U);
+
+			REQUIRE_EQ(index.find("upnp:rootdevice", plan), 1U);
+			REQUIRE(plan.target() == SearchTarget::root);
+
+			// Later versions satisfy requests for earlier ones, and ST must echo the version requested
+			REQUIRE_EQ(index.find("urn:test-index-org:device:Lookup:1", plan), 2U);
+			REQUIRE(plan.target() == SearchTarget::type);
+			REQUIRE(plan.searchKey().getKind() == Urn::Kind::device);
+			REQUIRE_EQ(plan.searchKey().version, 1);
+			REQUIRE_EQ(index.find("urn:test-index-org:device:Lookup:2", plan), 2U);
+			REQUIRE_EQ(index.find("urn:test-index-org:device:Lookup:3", plan), 1U);
+			REQUIRE_EQ(index.find("urn:test-index-org:device:Lookup:4", plan), 0U);
+
+			REQUIRE_EQ(index.find("urn:test-index-org:service:Lookup:1", plan), 1U);
+			REQUIRE(plan.searchKey().getKind() == Urn::Kind::service);
+
+			// Strings never registered, so nothing can match
+			REQUIRE_EQ(index.find("urn:test-index-org:device:Unregistered:1", plan), 0U);
+			REQUIRE_EQ(index.find("urn:test-index-unregistered:device:Lookup:1", plan), 0U);
+
+			// Device UUIDs are handled by the device registry
+			REQUIRE_EQ(index.find("uuid:2fac1234-31f8-11b4-a222-08002b34c003", plan), 0U);
+
+			REQUIRE_EQ(index.find("ssdp:all", plan), index.count());
+			REQUIRE(plan.target() == SearchTarget::all);
+		}
+
+		TEST_CASE("Cursor encoding")
+		{
+			SearchIndex index;
+			populate(index);
+
+			// Start at first match, which is the device in slot 1, within the bucket for the requested type
+			MessageSpec plan(MessageType::response);
+			REQUIRE_EQ(index.find("urn:test-index-org:device:Lookup:1", plan), 2U);
+			auto bucket = getCursor(plan) & cursorBucket;
+			REQUIRE_EQ(getCursor(plan), cursorValid | bucket | 1U);
+
+			// Position moves on within the same bucket
+			MessageSpec ms(MessageType::response);
+			REQUIRE(index.next(plan, ms));
+			REQUIRE_EQ(getCursor(plan), cursorValid | bucket | 2U);
+
+			// ssdp:all starts at the beginning of the first bucket
+			REQUIRE_EQ(index.find("ssdp:all", plan), index.count());
+			REQUIRE_EQ(getCursor(plan), cursorValid | cursorAll);
+			REQUIRE(index.next(plan, ms));
+			auto c = getCursor(plan);
+			REQUIRE_EQ(c & ~cursorBucket, cursorValid | cursorAll | (indexOf(objects, ms) + 1));
+
+			// A cursor without the valid bit, such as at the start of a repeat, produces nothing
+			plan.restart();
+			REQUIRE(plan.cursor<void>() == nullptr);
+			REQUIRE(!index.next(plan, ms));
+		}
+
+		TEST_CASE("Next response")
+		{
+			SearchIndex index;
+			populate(index);
+
+			MessageSpec plan(MessageType::response);
+			plan.setRemote(IpAddress(192, 168, 1, 10), 1900);
+			REQUIRE_EQ(index.find("urn:test-index-org:device:Lookup:1", plan), 2U);
+
+			// Matches come in table order, each a copy of the plan carrying its search key
+			void* expected[]{&objects[1], &objects[3]};
+			for(auto object : expected) {
+				MessageSpec ms(MessageType::response);
+				REQUIRE(index.hasNext(plan));
+				REQUIRE(index.next(plan, ms));
+				REQUIRE(ms.object<void>() == object);
+				REQUIRE(ms.match() == SearchMatch::type);
+				REQUIRE(ms.remoteIp() == plan.remoteIp());
+				REQUIRE(!ms.isFanOut());
+				REQUIRE_EQ(ms.searchKey().version, 1);
+			}
+			// End of search is known as soon as the last response has been produced
+			REQUIRE(!index.hasNext(plan));
+			MessageSpec ms(MessageType::response);
+			REQUIRE(!index.next(plan, ms));
+
+			// Every entry is produced once, each with the match for its kind
+			REQUIRE_EQ(index.find("ssdp:all", plan), 4U);
+			SearchMatch matches[]{SearchMatch::root, SearchMatch::type, SearchMatch::type, SearchMatch::type};
+			unsigned seen[4]{};
+			for(unsigned i = 0; i < 4; ++i) {
+				REQUIRE(index.next(plan, ms));
+				auto n = indexOf(objects, ms);
+				REQUIRE(n < 4);
+				++seen[n];
+				REQUIRE(ms.match() == matches[n]);
+			}
+			REQUIRE(!index.next(plan, ms));
+			for(auto n : seen) {
+				REQUIRE_EQ(n, 1U);
+			}
+		}
+
+		TEST_CASE("Remove during search")
+		{
+			SearchIndex index;
+			populate(index);
+
+			MessageSpec plan(MessageType::response);
+			REQUIRE_EQ(index.find("ssdp:all", plan), 4U);
+			MessageSpec ms(MessageType::response);
+			REQUIRE(index.next(plan, ms));
+			auto first = indexOf(objects, ms);
+
+			// Entries not yet reached are skipped
+			auto removed = (first + 1) % 4;
+			index.remove(&objects[removed]);
+			REQUIRE_EQ(index.count(), 3U);
+			unsigned count{0};
+			while(index.next(plan, ms)) {
+				auto n = indexOf(objects, ms);
+				REQUIRE(n != first && n != removed);
+				++count;
+			}
+			REQUIRE_EQ(count, 2U);
+
+			// Removing the last match ends the search early
+			index.clear();
+			populate(index);
+			REQUIRE_EQ(index.find("urn:test-index-org:device:Lookup:1", plan), 2U);
+			REQUIRE(index.next(plan, ms));
+			REQUIRE(ms.object<void>() == &objects[1]);
+			index.remove(&objects[3]);
+			REQUIRE(!index.hasNext(plan));
+
+			// First freed slot is re-used
+			index.remove(&objects[1]);
+			REQUIRE(index.add(Urn("urn:test-index-org:device:Lookup:2"), &objects[1]));
+			REQUIRE_EQ(index.find("urn:test-index-org:device:Lookup:2", plan), 1U);
+			REQUIRE_EQ(getCursor(plan) & ~cursorBucket, cursorValid | 1U);
+		}
+
+		TEST_CASE("URN with non-standard UUID")
+		{
+			// Only domain and type are indexed so the UUID doesn't matter
+			SearchIndex index;
+			REQUIRE(index.add(Urn(String(legacyDeviceUrn)), &objects[0]));
+			REQUIRE_EQ(index.count(), 1U);
+			MessageSpec plan(MessageType::response);
+			REQUIRE_EQ(index.find("urn:test-index-org:device:Widget:1", plan), 1U);
+		}
+	}
+
+private:
+	/*
+	 * Fill slots 0-3 of an empty index
+	 */
+	void populate(SearchIndex& index)
+	{
+		REQUIRE(index.add(Urn("upnp:rootdevice"), &objects[0]));
+		REQUIRE(index.add(Urn("urn:test-index-org:device:Lookup:2"), &objects[1]));
+		REQUIRE(index.add(Urn("urn:test-index-org:service:Lookup:1"), &objects[2]));
+		REQUIRE(index.add(Urn("urn:test-index-org:device:Lookup:3"), &objects[3]));
+		REQUIRE_EQ(index.count(), 4U);
+	}
+
+	uint8_t objects[4]{};
+};
+
+void REGISTER_TEST(SearchIndex)
+{
+	registerGroup<SearchIndexTest>();
+}
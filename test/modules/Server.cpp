@@ -0,0 +1,167 @@
+#include <SmingTest.h>
+#include <Network/SSDP/Server.h>
+
+namespace
+{
+using SSDP::MessagePool;
+using SSDP::Server;
+using SSDP::Trace;
+
+DEFINE_FSTR_LOCAL(searchRequest, "M-SEARCH * HTTP/1.1\r\n"
+								 "HOST: 239.255.255.250:1900\r\n"
+								 "MAN: \"ssdp:discover\"\r\n"
+								 "MX: 1\r\n"
+								 "ST: urn:test-server-org:device:Widget:1\r\n"
+								 "\r\n")
+
+void search(Server& server)
+{
+	// Text is modified during parsing
+	String data(searchRequest);
+	server.receive(data.begin(), data.length(), IpAddress(192, 168, 1, 10), 1900);
+}
+
+unsigned poolUsage()
+{
+	auto& stats = MessagePool::getStats();
+	return stats.used + stats.heapUsed;
+}
+
+} // namespace
+
+namespace SSDP
+{
+class ServerTest : public TestGroup
+{
+public:
+	ServerTest() : TestGroup(_F("Server"))
+	{
+	}
+
+	void execute() override
+	{
+		TEST_CASE("Instance numbering")
+		{
+			Server a;
+			Server b;
+			REQUIRE(a.getInstance() != SSDP::server.getInstance());
+			REQUIRE_EQ(b.getInstance(), uint8_t(a.getInstance() + 1));
+		}
+
+		TEST_CASE("Independent state")
+		{
+			Server a;
+			Server b;
+			a.setSearchWindow(SSDP::SearchHistory::recommendedWindowMs);
+			b.setSearchWindow(SSDP::SearchHistory::recommendedWindowMs);
+			REQUIRE(a.addSearchTarget(Urn("urn:test-server-org:device:Widget:1"), &objects[0]));
+
+			// Only the server hosting the target responds
+			search(a);
+			search(b);
+			REQUIRE_EQ(a.messageQueue.count(), 1U);
+			REQUIRE_EQ(b.messageQueue.count(), 0U);
+
+			// Duplicate requests are tracked per server
+			search(a);
+			search(b);
+			REQUIRE_EQ(a.suppressedSearches(), 1U);
+			REQUIRE_EQ(b.suppressedSearches(), 0U);
+			REQUIRE_EQ(a.messageQueue.count(), 1U);
+		}
+
+		TEST_CASE("Shared state")
+		{
+			auto used = poolUsage();
+			{
+				Server a;
+				Server b;
+				REQUIRE(a.addSearchTarget(Urn("urn:test-server-org:device:Widget:1"), &objects[0]));
+
+				// Strings interned by one server are visible to all, but only registered targets match
+				REQUIRE(UrnStrings::find("test-server-org", 15) != UrnStrings::none);
+				search(b);
+				REQUIRE_EQ(b.messageQueue.count(), 0U);
+
+				// Messages queued by any server come from the one pool
+				search(a);
+				REQUIRE(poolUsage() > used);
+			}
+			// and are returned to it when the server is destroyed
+			REQUIRE_EQ(poolUsage(), used);
+		}
+
+#if SSDP_ENABLE_TRACE
+		TEST_CASE("Trace records identify server")
+		{
+			Server a;
+			Server b;
+			Trace::clear();
+			search(a);
+			search(b);
+			search(b);
+
+			Trace::Entry entries[16];
+			auto count = Trace::read(entries, ARRAY_SIZE(entries));
+			unsigned received[2]{};
+			unsigned parsed[2]{};
+			for(unsigned i = 0; i < count; ++i) {
+				auto& e = entries[i];
+				REQUIRE(e.instance == a.getInstance() || e.instance == b.getInstance());
+				if(e.event == Trace::Event::receive) {
+					++received[e.instance == b.getInstance()];
+				} else if(e.event == Trace::Event::parse) {
+					++parsed[e.instance == b.getInstance()];
+				}
+			}
+			// Injected datagrams are traced as for those from the network
+			REQUIRE_EQ(received[0], 1U);
+			REQUIRE_EQ(received[1], 2U);
+			REQUIRE_EQ(parsed[0], 1U);
+			REQUIRE_EQ(parsed[1], 2U);
+		}
+#endif
+
+		TEST_CASE("Response echoes requested version")
+		{
+			Server a;
+			String sent;
+			a.setSendSink([&](IpAddress, uint16_t, const char* data, size_t length) {
+				sent.setString(data, length);
+				return true;
+			});
+			// Application reports the version it hosts
+			a.setDelegates(nullptr, [&](Message& msg, MessageSpec&) {
+				msg["ST"] = F("urn:test-server-org:device:Widget:2");
+				a.sendMessage(msg);
+			});
+			REQUIRE(a.addSearchTarget(Urn("urn:test-server-org:device:Widget:2"), &objects[0]));
+
+			for(unsigned version : {1, 2}) {
+				String st = F("urn:test-server-org:device:Widget:");
+				st += version;
+				MessageSpec plan(MessageType::response);
+				plan.setRemote(IpAddress(192, 168, 1, 10), 1900);
+				REQUIRE_EQ(a.searchIndex.find(st.c_str(), plan), 1U);
+				MessageSpec ms(MessageType::response);
+				REQUIRE(a.searchIndex.next(plan, ms));
+				sent = "";
+				a.dispatch(ms);
+				String expected = F("\r\nST: ");
+				expected += st;
+				expected += "\r\n";
+				REQUIRE(sent.indexOf(expected) >= 0);
+			}
+		}
+	}
+
+private:
+	uint8_t objects[1]{};
+};
+
+} // namespace SSDP
+
+void REGISTER_TEST(Server)
+{
+	registerGroup<SSDP::ServerTest>();
+}
@@ -0,0 +1,189 @@
+#include <SmingTest.h>
+#include <Network/SSDP/Server.h>
+
+namespace SSDP
+{
+class TemplateCacheTest : public TestGroup
+{
+public:
+	TemplateCacheTest() : TestGroup(_F("TemplateCache"))
+	{
+	}
+
+	void execute() override
+	{
+		if(TemplateCache::capacity < 2) {
+			Serial << _F("Template cache too small, skipping") << endl;
+			return;
+		}
+
+		TEST_CASE("Find and invalidate by object")
+		{
+			TemplateCache cache;
+			MessageSpec alive(NotifySubtype::alive, SearchTarget::root, &objects[0]);
+			MessageSpec response(MessageType::response, SearchTarget::root, &objects[1]);
+			cache.store(alive, F("NOTIFY * HTTP/1.1\r\n\r\n"));
+			cache.store(response, F("HTTP/1.1 200 OK\r\n\r\n"));
+			REQUIRE(cache.find(alive) != nullptr);
+			REQUIRE(cache.find(response) != nullptr);
+
+			// Same object, different message
+			MessageSpec byebye(NotifySubtype::byebye, SearchTarget::root, &objects[0]);
+			REQUIRE(cache.find(byebye) == nullptr);
+
+			cache.invalidate(&objects[0]);
+			REQUIRE(cache.find(alive) == nullptr);
+			REQUIRE(cache.find(response) != nullptr);
+		}
+
+		TEST_CASE("Keyed on requested search target")
+		{
+			TemplateCache cache;
+			MessageSpec base(MessageType::response, SearchTarget::type);
+			MessageSpec v1(base, SearchMatch::type, &objects[0]);
+			SearchKey key;
+			key.kind = uint8_t(Urn::Kind::device);
+			key.domain = 1;
+			key.type = 2;
+			key.version = 1;
+			v1.setSearchKey(key);
+			MessageSpec v2(v1);
+			key.version = 2;
+			v2.setSearchKey(key);
+			MessageSpec otherType(v1);
+			key.version = 1;
+			key.type = 3;
+			otherType.setSearchKey(key);
+
+			cache.store(v1, F("HTTP/1.1 200 OK\r\n\r\n"));
+			REQUIRE(cache.find(v1) != nullptr);
+			REQUIRE(cache.find(v2) == nullptr);
+			REQUIRE(cache.find(otherType) == nullptr);
+		}
+
+		TEST_CASE("Variable fields located")
+		{
+			TemplateCache cache;
+			MessageSpec response(MessageType::response, SearchTarget::root, &objects[0]);
+			cache.store(response, F("HTTP/1.1 200 OK\r\n"
+									"DATE: Fri, 16 Oct 2026 10:00:00 GMT\r\n"
+									"EXT:\r\n"
+									"ST: upnp:rootdevice\r\n"
+									"USN: uuid:2fac1234-31f8-11b4-a222-08002b34c003::upnp:rootdevice\r\n"
+									"\r\n"));
+			auto entry = cache.find(response);
+			REQUIRE(entry != nullptr);
+			REQUIRE_EQ(unsigned(entry->fieldCount), 2U);
+			REQUIRE(entry->getField(TemplateCache::FieldId::host) == nullptr);
+			auto field = entry->getField(TemplateCache::FieldId::st);
+			REQUIRE(field != nullptr);
+			REQUIRE(entry->data.substring(field->offset, field->offset + field->length) == "upnp:rootdevice");
+			field = entry->getField(TemplateCache::FieldId::date);
+			REQUIRE(field != nullptr);
+			REQUIRE(entry->data.substring(field->offset, field->offset + field->length) ==
+					"Fri, 16 Oct 2026 10:00:00 GMT");
+		}
+
+		TEST_CASE("Fields regenerated on send")
+		{
+			Server server;
+			String sent;
+			unsigned built{0};
+			server.setSendSink([&](IpAddress, uint16_t, const char* data, size_t length) {
+				sent.setString(data, length);
+				return true;
+			});
+			server.setDelegates(nullptr, [&](Message& msg, MessageSpec&) {
+				++built;
+				msg["NT"] = UPNP_ROOTDEVICE;
+				msg["USN"] = F("uuid:2fac1234-31f8-11b4-a222-08002b34c003::upnp:rootdevice");
+				server.sendMessage(msg);
+			});
+
+			MessageSpec alive(NotifySubtype::alive, SearchTarget::root, &objects[0]);
+			alive.setRemote(IpAddress(239, 255, 255, 250), 1900);
+			server.dispatch(alive);
+			REQUIRE_EQ(built, 1U);
+			String expected = sent;
+			REQUIRE(expected.indexOf("\r\nHost: 239.255.255.250:1900\r\n") >= 0);
+
+			// Sent again from the template, to its own destination
+			alive.setRemote(IpAddress(192, 168, 1, 10), 50000);
+			server.dispatch(alive);
+			REQUIRE_EQ(built, 1U);
+			expected.replace("239.255.255.250:1900", "192.168.1.10:50000");
+			REQUIRE(sent == expected);
+		}
+
+		TEST_CASE("Search responses use their own templates")
+		{
+			Server server;
+			String sent;
+			unsigned built{0};
+			server.setSendSink([&](IpAddress, uint16_t, const char* data, size_t length) {
+				sent.setString(data, length);
+				return true;
+			});
+			// Application reports the version it hosts, which the server replaces with the version requested
+			server.setDelegates(nullptr, [&](Message& msg, MessageSpec&) {
+				++built;
+				msg["ST"] = F("urn:test-template-org:service:Widget:2");
+				server.sendMessage(msg);
+			});
+			REQUIRE(server.addSearchTarget(Urn("urn:test-template-org:service:Widget:2"), &objects[0]));
+			REQUIRE(server.addSearchTarget(Urn("urn:test-template-org:service:Gadget:1"), &objects[0]));
+
+			auto respond = [&](const char* st) {
+				MessageSpec plan(MessageType::response);
+				plan.setRemote(IpAddress(192, 168, 1, 10), 1900);
+				REQUIRE(server.searchIndex.find(st, plan) != 0);
+				MessageSpec ms(MessageType::response);
+				while(server.searchIndex.next(plan, ms)) {
+					server.dispatch(ms);
+				}
+			};
+
+			// Repeated request is answered from the template
+			respond("urn:test-template-org:service:Widget:1");
+			respond("urn:test-template-org:service:Widget:1");
+			REQUIRE_EQ(built, 1U);
+			REQUIRE(sent.indexOf("\r\nST: urn:test-template-org:service:Widget:1\r\n") >= 0);
+
+			// Request for a different version needs its own
+			respond("urn:test-template-org:service:Widget:2");
+			REQUIRE_EQ(built, 2U);
+			REQUIRE(sent.indexOf("\r\nST: urn:test-template-org:service:Widget:2\r\n") >= 0);
+
+			// ssdp:all responses for each service of one object are kept apart
+			built = 0;
+			respond("ssdp:all");
+			REQUIRE_EQ(built, 2U);
+		}
+
+		TEST_CASE("Discarded on removal from server")
+		{
+			Server server;
+			MessageSpec device(NotifySubtype::alive, SearchTarget::root, &objects[0]);
+			MessageSpec service(MessageType::response, SearchTarget::type, &objects[1]);
+			server.templates.store(device, F("NOTIFY * HTTP/1.1\r\n\r\n"));
+			server.templates.store(service, F("HTTP/1.1 200 OK\r\n\r\n"));
+
+			server.removeDevice(&objects[0]);
+			REQUIRE(server.templates.find(device) == nullptr);
+			REQUIRE(server.templates.find(service) != nullptr);
+
+			server.removeSearchTargets(&objects[1]);
+			REQUIRE(server.templates.find(service) == nullptr);
+		}
+	}
+
+private:
+	uint8_t objects[2]{};
+};
+
+} // namespace SSDP
+
+void REGISTER_TEST(TemplateCache)
+{
+	registerGroup<SSDP::TemplateCacheTest>();
+}
@@ -0,0 +1,164 @@
+#include <SmingTest.h>
+#include <Network/SSDP/CompactUrn.h>
+
+namespace
+{
+DEFINE_FSTR_LOCAL(deviceUrn, "uuid:2fac1234-31f8-11b4-a222-08002b34c003::urn:test-urn-org:device:Widget:2")
+DEFINE_FSTR_LOCAL(serviceUrn, "urn:test-urn-org:service:Gadget:1")
+// UPnP 1.0 places no requirement on UUID format
+DEFINE_FSTR_LOCAL(legacyUrn, "uuid:Upnp-Widget-1_0-1234567890001::urn:test-urn-org:device:Widget:1")
+
+bool isSlice(const UrnView::Slice& slice, const char* s)
+{
+	return slice.length == strlen(s) && memcmp(slice.ptr, s, slice.length) == 0;
+}
+
+} // namespace
+
+class UrnTest : public TestGroup
+{
+public:
+	UrnTest() : TestGroup(_F("Urn"))
+	{
+	}
+
+	void execute() override
+	{
+		TEST_CASE("UrnView decompose")
+		{
+			UrnView view("uuid:1234");
+			REQUIRE(view.kind == Urn::Kind::uuid);
+			REQUIRE(isSlice(view.uuid, "1234"));
+
+			REQUIRE(view.decompose("upnp:rootdevice"));
+			REQUIRE(view.kind == Urn::Kind::root);
+			REQUIRE(!view.uuid);
+
+			REQUIRE(view.decompose("uuid:1234::upnp:rootdevice"));
+			REQUIRE(view.kind == Urn::Kind::root);
+			REQUIRE(isSlice(view.uuid, "1234"));
+
+			String s(deviceUrn);
+			REQUIRE(view.decompose(s.c_str()));
+			REQUIRE(view.kind == Urn::Kind::device);
+			REQUIRE(isSlice(view.uuid, "2fac1234-31f8-11b4-a222-08002b34c003"));
+			REQUIRE(isSlice(view.domain, "test-urn-org"));
+			REQUIRE(isSlice(view.type, "Widget"));
+			REQUIRE_EQ(view.version, 2);
+
+			s = String(serviceUrn);
+			REQUIRE(view.decompose(s.c_str()));
+			REQUIRE(view.kind == Urn::Kind::service);
+			REQUIRE(!view.uuid);
+			REQUIRE(isSlice(view.type, "Gadget"));
+			REQUIRE_EQ(view.version, 1);
+		}
+
+		TEST_CASE("UrnView rejects malformed text")
+		{
+			for(auto s : {"", "uuid", "urn:test-urn-org:widget:Widget:1", "uuid:1234:urn:test-urn-org:device:Widget:1",
+						  "urn:test-urn-org:device", "upnp:rootdevices"}) {
+				UrnView view(s);
+				REQUIRE(!view);
+				REQUIRE(view.kind == Urn::Kind::none);
+			}
+		}
+
+		TEST_CASE("UrnView within larger buffer")
+		{
+			// Text need not be nul-terminated
+			String s(serviceUrn);
+			s += F("\r\nUSN: uuid:1234");
+			UrnView view(s.c_str(), String(serviceUrn).length());
+			REQUIRE(view.kind == Urn::Kind::service);
+			REQUIRE_EQ(view.version, 1);
+			REQUIRE(view == Urn(String(serviceUrn)));
+		}
+
+		TEST_CASE("UrnView compare and copy")
+		{
+			String s(deviceUrn);
+			UrnView view(s.c_str());
+			Urn urn(s);
+			REQUIRE(view == urn);
+			REQUIRE(urn == view);
+			REQUIRE(view.toUrn() == urn);
+			REQUIRE(view.toUrn().toString() == s);
+
+			urn.version = 3;
+			REQUIRE(view != urn);
+			REQUIRE(view != Urn(String(serviceUrn)));
+		}
+
+		TEST_CASE("UrnStrings")
+		{
+			REQUIRE_EQ(UrnStrings::find("urn-strings-test", 16), UrnStrings::none);
+			REQUIRE_EQ(UrnStrings::intern("", 0), UrnStrings::none);
+			REQUIRE(UrnStrings::get(UrnStrings::none) == nullptr);
+
+			auto count = UrnStrings::count();
+			auto id = UrnStrings::intern("urn-strings-test", 16);
+			REQUIRE(id != UrnStrings::none);
+			REQUIRE_EQ(UrnStrings::count(), count + 1);
+			REQUIRE(strcmp(UrnStrings::get(id), "urn-strings-test") == 0);
+			REQUIRE(UrnStrings::get(UrnStrings::count() + 1) == nullptr);
+
+			// Interning again returns the existing string
+			REQUIRE_EQ(UrnStrings::intern("urn-strings-test", 16), id);
+			REQUIRE_EQ(UrnStrings::find("urn-strings-test", 16), id);
+			REQUIRE_EQ(UrnStrings::count(), count + 1);
+
+			// Only the given length is used, and a prefix is a different string
+			REQUIRE_EQ(UrnStrings::find("urn-strings-test-other", 16), id);
+			REQUIRE_EQ(UrnStrings::find("urn-strings", 11), UrnStrings::none);
+			auto prefix = UrnStrings::intern("urn-strings", 11);
+			REQUIRE(prefix != UrnStrings::none && prefix != id);
+			REQUIRE(strcmp(UrnStrings::get(id), "urn-strings-test") == 0);
+		}
+
+		TEST_CASE("CompactUrn")
+		{
+			REQUIRE_EQ(sizeof(Urn::Kind), 1U);
+			REQUIRE_EQ(sizeof(CompactUrn), sizeof(Uuid) + 4);
+
+			Urn urn{String(deviceUrn)};
+			CompactUrn cu;
+			REQUIRE(cu.fromUrn(urn));
+			REQUIRE(cu.kind == Urn::Kind::device);
+			REQUIRE_EQ(cu.version, 2);
+			REQUIRE(cu.toUrn() == urn);
+			REQUIRE(cu.toString() == String(deviceUrn));
+
+			// Matching a view only uses strings already interned
+			String s(deviceUrn);
+			CompactUrn other;
+			REQUIRE(other.find(UrnView(s.c_str())));
+			REQUIRE(other == cu);
+			REQUIRE_EQ(other.hash(), cu.hash());
+
+			REQUIRE(other.find(RootDeviceUrn()));
+			REQUIRE(other != cu);
+
+			REQUIRE(!other.find(Urn("urn:test-urn-org:device:Unknown:1")));
+			REQUIRE(!other);
+			REQUIRE(!other.find(Urn("urn:test-urn-org-unknown:device:Widget:1")));
+		}
+
+		TEST_CASE("CompactUrn with non-standard UUID")
+		{
+			Urn urn{String(legacyUrn)};
+			REQUIRE(urn.kind == Urn::Kind::device);
+			REQUIRE(urn.toString() == String(legacyUrn));
+
+			// The UUID cannot be held in binary form, so this is reported as a failure
+			CompactUrn cu;
+			REQUIRE(!cu.fromUrn(urn));
+			REQUIRE(!cu);
+		}
+	}
+};
+
+void REGISTER_TEST(Urn)
+{
+	registerGroup<UrnTest>();
+}
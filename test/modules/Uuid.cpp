@@ -0,0 +1,149 @@
+#include <SmingTest.h>
+#include <Network/SSDP/Uuid.h>
+
+namespace
+{
+DEFINE_FSTR_LOCAL(uuidString, "2fac1234-31f8-11b4-a222-08002b34c003")
+DEFINE_FSTR_LOCAL(uuidUpper, "2FAC1234-31F8-11B4-A222-08002B34C003")
+
+} // namespace
+
+class UuidTest : public TestGroup
+{
+public:
+	UuidTest() : TestGroup(_F("Uuid"))
+	{
+	}
+
+	void execute() override
+	{
+		const String text(uuidString);
+		const Uuid reference(text);
+
+		TEST_CASE("Decompose")
+		{
+			REQUIRE(reference);
+			REQUIRE_EQ(reference.time_low, 0x2fac1234U);
+			REQUIRE_EQ(reference.time_mid, 0x31f8);
+			REQUIRE_EQ(reference.time_hi_and_version, 0x11b4);
+			REQUIRE_EQ(reference.clock_seq_hi_and_reserved, 0xa2);
+			REQUIRE_EQ(reference.clock_seq_low, 0x22);
+			const uint8_t node[]{0x08, 0x00, 0x2b, 0x34, 0xc0, 0x03};
+			REQUIRE(memcmp(reference.node, node, sizeof(node)) == 0);
+		}
+
+		TEST_CASE("Round trip")
+		{
+			char buf[Uuid::stringSize + 1];
+			memset(buf, 0xff, sizeof(buf));
+			REQUIRE_EQ(reference.toString(buf, Uuid::stringSize), Uuid::stringSize);
+			REQUIRE_EQ(uint8_t(buf[Uuid::stringSize]), 0xff);
+			buf[Uuid::stringSize] = '\0';
+			REQUIRE(text == buf);
+			REQUIRE_EQ(reference.toString(buf, Uuid::stringSize - 1), 0U);
+
+			REQUIRE(text == reference.toString());
+			REQUIRE(Uuid(reference.toString()) == reference);
+
+			// Every bit position survives conversion
+			Uuid uuid;
+			for(unsigned i = 0; i < sizeof(Uuid); ++i) {
+				auto bytes = reinterpret_cast<uint8_t*>(&uuid);
+				for(unsigned bit = 0; bit < 8; ++bit) {
+					bytes[i] = 1U << bit;
+					Uuid copy(uuid.toString());
+					REQUIRE(copy == uuid);
+				}
+				bytes[i] = 0;
+			}
+		}
+
+		TEST_CASE("Uppercase input")
+		{
+			Uuid uuid(uuidUpper);
+			REQUIRE(uuid == reference);
+			// Output is always lowercase
+			REQUIRE(text == uuid.toString());
+
+			char mixed[Uuid::stringSize];
+			memcpy(mixed, text.c_str(), sizeof(mixed));
+			mixed[0] = 'F';
+			mixed[35] = 'b';
+			Uuid other;
+			REQUIRE(other.decompose(mixed, sizeof(mixed)));
+			REQUIRE_EQ(other.time_low, 0xffac1234U);
+			REQUIRE_EQ(other.node[5], 0x0b);
+		}
+
+		TEST_CASE("Non-hex characters")
+		{
+			// Characters either side of the valid ranges, and those which differ only by case bit
+			for(char c : {'g', 'G', '/', ':', '@', '`', 'z', ' ', '\0', '\x80', '\xff', '-'}) {
+				for(unsigned pos : {0, 7, 9, 17, 24, 35}) {
+					char s[Uuid::stringSize];
+					memcpy(s, text.c_str(), sizeof(s));
+					s[pos] = c;
+					REQUIRE(!check(s, sizeof(s)));
+				}
+			}
+		}
+
+		TEST_CASE("Wrong length")
+		{
+			REQUIRE(!check(text.c_str(), text.length() - 1));
+			REQUIRE(!check(text.c_str(), 0));
+			REQUIRE(!check(nullptr, Uuid::stringSize));
+			String s(text);
+			s += '0';
+			REQUIRE(!check(s.c_str(), s.length()));
+
+			Uuid uuid(reference);
+			REQUIRE(!uuid.decompose(static_cast<const char*>(nullptr)));
+			REQUIRE(!uuid.decompose(""));
+			REQUIRE(uuid == reference);
+		}
+
+		TEST_CASE("Misplaced dashes")
+		{
+			// Dash moved one place in either direction
+			for(unsigned pos : {8, 13, 18, 23}) {
+				for(int shift : {-1, 1}) {
+					char s[Uuid::stringSize];
+					memcpy(s, text.c_str(), sizeof(s));
+					std::swap(s[pos], s[pos + shift]);
+					REQUIRE(!check(s, sizeof(s)));
+				}
+			}
+
+			// No dashes, padded to the right length
+			char s[Uuid::stringSize];
+			memset(s, '0', sizeof(s));
+			for(unsigned i = 0, n = 0; i < text.length(); ++i) {
+				if(text[i] != '-') {
+					s[n++] = text[i];
+				}
+			}
+			REQUIRE(!check(s, sizeof(s)));
+		}
+	}
+
+private:
+	/*
+	 * Attempt to decode, checking a failure leaves the UUID unchanged
+	 */
+	bool check(const char* s, size_t len)
+	{
+		Uuid uuid(uuidString);
+		Uuid original(uuid);
+		if(uuid.decompose(s, len)) {
+			return true;
+		}
+		REQUIRE(uuid == original);
+		return false;
+	}
+};
+
+void REGISTER_TEST(Uuid)
+{
+	registerGroup<UuidTest>();
+}